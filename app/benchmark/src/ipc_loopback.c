@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * In-process replacement for ipc_endpoint.c, used where there is no second core (i.e. native_sim).
+ * The real crypto and settings servers are built into this image as well (see loopback_server.h)
+ * and use the server side of the loopback, the client uses the normal IPC endpoint functions.
+ * Messages are queued to a thread for each side which passes them to the handlers registered on
+ * that side, like the ICMsg workqueue does on each core.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <psa/crypto.h>
+#include "ipc_endpoint.h"
+#include "ipc_settings.h"
+#include "ipc_loopback.h"
+
+LOG_MODULE_REGISTER(ipc_loopback, 4);
+
+/* Requests are answered one at a time, the server can send a window of boot load frames */
+#define LOOPBACK_CLIENT_QUEUE_SIZE 4
+#define LOOPBACK_SERVER_QUEUE_SIZE 8
+#define LOOPBACK_THREAD_STACK_SIZE 4096
+
+struct ipc_payload {
+	uint8_t opcode;
+	uint16_t size;
+	uint8_t data[IPC_MESSAGE_DATA_SIZE];
+};
+
+/* One end of the loopback, messages sent from it are queued to the other end */
+struct loopback_side {
+	const char *name;
+	sys_slist_t handlers;
+	struct k_mutex *lock;
+	struct k_msgq *queue;
+	struct k_msgq *peer_queue;
+	struct ipc_payload transmit;
+	struct ipc_payload receive;
+};
+
+static void loopback_thread_entry(void *p1, void *p2, void *p3);
+
+/* Each queue holds the messages sent by that side */
+static K_MSGQ_DEFINE(loopback_client_queue, sizeof(struct ipc_payload), LOOPBACK_CLIENT_QUEUE_SIZE, 4);
+static K_MSGQ_DEFINE(loopback_server_queue, sizeof(struct ipc_payload), LOOPBACK_SERVER_QUEUE_SIZE, 4);
+static K_MUTEX_DEFINE(loopback_client_lock);
+static K_MUTEX_DEFINE(loopback_server_lock);
+
+static struct loopback_side loopback_client = {
+	.name = "client",
+	.handlers = SYS_SLIST_STATIC_INIT(&loopback_client.handlers),
+	.lock = &loopback_client_lock,
+	.queue = &loopback_server_queue,
+	.peer_queue = &loopback_client_queue,
+};
+
+static struct loopback_side loopback_server = {
+	.name = "server",
+	.handlers = SYS_SLIST_STATIC_INIT(&loopback_server.handlers),
+	.lock = &loopback_server_lock,
+	.queue = &loopback_client_queue,
+	.peer_queue = &loopback_server_queue,
+};
+
+static K_SEM_DEFINE(ipc_bound_sem, 0, 1);
+
+K_THREAD_DEFINE(loopback_server_thread, LOOPBACK_THREAD_STACK_SIZE, loopback_thread_entry,
+		&loopback_server, NULL, NULL, K_PRIO_COOP(2), 0, 0);
+K_THREAD_DEFINE(loopback_client_thread, LOOPBACK_THREAD_STACK_SIZE, loopback_thread_entry,
+		&loopback_client, NULL, NULL, K_PRIO_COOP(2), 0, 0);
+
+static void loopback_thread_entry(void *p1, void *p2, void *p3)
+{
+	struct loopback_side *side = (struct loopback_side *)p1;
+	struct ipc_payload *message = &side->receive;
+	struct ipc_group *group;
+	bool handled;
+
+	while (1) {
+		(void)k_msgq_get(side->queue, message, K_FOREVER);
+		handled = false;
+
+		SYS_SLIST_FOR_EACH_CONTAINER(&side->handlers, group, node) {
+			if (group->opcode == message->opcode) {
+				(void)group->callback(message->data, message->size, group->user_data);
+				handled = true;
+				break;
+			}
+		}
+
+		if (!handled) {
+			LOG_ERR("No %s handler for opcode %d", side->name, message->opcode);
+		}
+	}
+}
+
+static uint8_t *loopback_get_buffer(struct loopback_side *side)
+{
+	(void)k_mutex_lock(side->lock, K_FOREVER);
+
+	return side->transmit.data;
+}
+
+static int loopback_send_buffer(struct loopback_side *side, uint8_t opcode, uint16_t size)
+{
+	int rc = -EMSGSIZE;
+
+	if (size <= sizeof(side->transmit.data)) {
+		side->transmit.opcode = opcode;
+		side->transmit.size = size;
+		rc = k_msgq_put(side->peer_queue, &side->transmit, K_FOREVER);
+
+		if (rc == 0) {
+			rc = size;
+		}
+	}
+
+	k_mutex_unlock(side->lock);
+
+	return rc;
+}
+
+static int loopback_send_message(struct loopback_side *side, uint8_t opcode, uint16_t size,
+				 const uint8_t *message)
+{
+	uint8_t *buffer;
+
+	if (size > sizeof(side->transmit.data)) {
+		return -EMSGSIZE;
+	}
+
+	buffer = loopback_get_buffer(side);
+
+	if (size > 0) {
+		memcpy(buffer, message, size);
+	}
+
+	return loopback_send_buffer(side, opcode, size);
+}
+
+/* Brings up the servers the same way the application core does before the client can use them */
+int ipc_setup(void)
+{
+	int rc;
+
+	if (psa_crypto_init() != PSA_SUCCESS) {
+		LOG_ERR("Crypto init failed");
+		return -EIO;
+	}
+
+	rc = settings_subsys_init();
+
+	if (rc == 0) {
+		rc = settings_load();
+	}
+
+	if (rc != 0) {
+		LOG_ERR("Settings init failed: %d", rc);
+		return rc;
+	}
+
+	ipc_setting_server_ready();
+	k_sem_give(&ipc_bound_sem);
+
+	return 0;
+}
+
+int ipc_wait_for_ready()
+{
+	k_sem_take(&ipc_bound_sem, K_FOREVER);
+	return 0;
+}
+
+int ipc_send_message(uint8_t opcode, uint16_t size, const uint8_t *message)
+{
+	return loopback_send_message(&loopback_client, opcode, size, message);
+}
+
+uint8_t *ipc_get_buffer(void)
+{
+	return loopback_get_buffer(&loopback_client);
+}
+
+int ipc_send_buffer(uint8_t opcode, uint16_t size)
+{
+	return loopback_send_buffer(&loopback_client, opcode, size);
+}
+
+void ipc_register(struct ipc_group *group)
+{
+	sys_slist_append(&loopback_client.handlers, &group->node);
+}
+
+void ipc_unregister(struct ipc_group *group)
+{
+	(void)sys_slist_find_and_remove(&loopback_client.handlers, &group->node);
+}
+
+int ipc_loopback_server_send_message(uint8_t opcode, uint16_t size, const uint8_t *message)
+{
+	return loopback_send_message(&loopback_server, opcode, size, message);
+}
+
+uint8_t *ipc_loopback_server_get_buffer(void)
+{
+	return loopback_get_buffer(&loopback_server);
+}
+
+int ipc_loopback_server_send_buffer(uint8_t opcode, uint16_t size)
+{
+	return loopback_send_buffer(&loopback_server, opcode, size);
+}
+
+void ipc_loopback_server_register(struct ipc_group *group)
+{
+	sys_slist_append(&loopback_server.handlers, &group->node);
+}
+
+void ipc_loopback_server_unregister(struct ipc_group *group)
+{
+	(void)sys_slist_find_and_remove(&loopback_server.handlers, &group->node);
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#ifndef APP_IPC_LOOPBACK_H
+#define APP_IPC_LOOPBACK_H
+
+#include <stdint.h>
+#include "ipc_endpoint.h"
+
+/* Server side of the loopback transport, the same as the IPC endpoint functions of the client
+ * side. The servers built into the benchmark use these in place of the IPC endpoint functions
+ */
+int ipc_loopback_server_send_message(uint8_t opcode, uint16_t size, const uint8_t *message);
+uint8_t *ipc_loopback_server_get_buffer(void);
+int ipc_loopback_server_send_buffer(uint8_t opcode, uint16_t size);
+void ipc_loopback_server_register(struct ipc_group *group);
+void ipc_loopback_server_unregister(struct ipc_group *group);
+
+#endif /* APP_IPC_LOOPBACK_H */
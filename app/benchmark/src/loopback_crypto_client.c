@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/* Crypto client, built without the server which is enabled for loopback_crypto_server.c */
+
+#undef CONFIG_IPC_LORAWAN_CRYPTO_SERVER
+
+#include "../../src/ipc_crypto.c"
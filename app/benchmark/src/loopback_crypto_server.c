@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/* Crypto server answering the benchmark's requests, see loopback_server.h */
+
+#include "loopback_server.h"
+
+#undef CONFIG_IPC_LORAWAN_CRYPTO_CLIENT
+
+#include "../../src/ipc_crypto.c"
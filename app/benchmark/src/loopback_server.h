@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * Included before the application core's ipc_settings.c or ipc_crypto.c to build it as a server
+ * on the server side of the loopback transport, in the same image as the client. Its IPC endpoint
+ * calls go to the server side and its log module is renamed so it does not clash with the client.
+ */
+
+#ifndef APP_LOOPBACK_SERVER_H
+#define APP_LOOPBACK_SERVER_H
+
+#include "ipc_loopback.h"
+
+#define ipc_send_message ipc_loopback_server_send_message
+#define ipc_get_buffer ipc_loopback_server_get_buffer
+#define ipc_send_buffer ipc_loopback_server_send_buffer
+#define ipc_register ipc_loopback_server_register
+#define ipc_unregister ipc_loopback_server_unregister
+
+#define ipc_settings ipc_settings_server
+#define ipc_crypto ipc_crypto_server
+
+#endif /* APP_LOOPBACK_SERVER_H */
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/* Settings client, built without the server which is enabled for loopback_settings_server.c */
+
+#undef CONFIG_IPC_SETTINGS_SERVER
+#undef CONFIG_IPC_SETTINGS_JOURNAL
+#undef CONFIG_IPC_SETTINGS_IDLE_GC
+#undef CONFIG_IPC_SETTINGS_INDEX
+
+#include "../../src/ipc_settings.c"
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/* Settings server answering the benchmark's requests, see loopback_server.h */
+
+#include "loopback_server.h"
+
+#undef CONFIG_IPC_SETTINGS_CLIENT
+#undef CONFIG_IPC_SETTINGS_CACHE
+#undef CONFIG_IPC_SETTINGS_WARM_SYNC
+
+/* Also built into the client */
+#define ipc_setting_id_name ipc_loopback_server_setting_id_name
+#define ipc_setting_id_find ipc_loopback_server_setting_id_find
+
+#include "../../src/ipc_settings.c"
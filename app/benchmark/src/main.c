@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "ipc_endpoint.h"
+#include "ipc_settings.h"
+#include "ipc_crypto.h"
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+#include "aes.h"
+#include "cmac.h"
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK)
+#include "secure-element.h"
+#include "soft-se-mod.h"
+#endif
+#elif defined(CONFIG_MBEDTLS_PSA_CRYPTO_C)
+#include <psa/crypto.h>
+#include <psa/crypto_extra.h>
+#endif
+
+#ifdef CONFIG_ARCH_POSIX
+#include "posix_board_if.h"
+#endif
+
+LOG_MODULE_REGISTER(benchmark, 4);
+
+#if (CONFIG_APP_BENCHMARK_CRYPTO_MAX_SIZE % 16) != 0 || (CONFIG_APP_BENCHMARK_CRYPTO_SIZE_STEP % 16) != 0
+#error "Crypto benchmark sizes must be a multiple of the AES block size"
+#endif
+
+#ifdef CONFIG_NATIVE_LIBRARY
+/* Simulated time does not advance while code executes on native_sim, the host clock in ns is used
+ * as the cycle counter instead
+ */
+uint64_t benchmark_host_time_ns(void);
+
+#define BENCHMARK_CYCLES() ((uint32_t)benchmark_host_time_ns())
+#define BENCHMARK_CYCLES_TO_NS(cycles) (cycles)
+#else
+#define BENCHMARK_CYCLES() k_cycle_get_32()
+#define BENCHMARK_CYCLES_TO_NS(cycles) k_cyc_to_ns_floor64(cycles)
+#endif
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+#define BENCHMARK_LOCAL "soft-se"
+#elif defined(CONFIG_MBEDTLS_PSA_CRYPTO_C)
+#define BENCHMARK_LOCAL "psa"
+#endif
+
+#define BENCHMARK_KEY_ID 0xf0
+#define BENCHMARK_KEY_SIZE 16
+#define BENCHMARK_CMAC_SIZE 16
+#define BENCHMARK_SETTING_NAME "benchmark/value"
+
+enum benchmark_operation {
+	BENCHMARK_AES128_ECB,
+	BENCHMARK_CMAC_AES128,
+	BENCHMARK_SETTING_SAVE,
+	BENCHMARK_SETTING_LOAD,
+	BENCHMARK_SETTING_COMMIT,
+
+	BENCHMARK_OPERATION_COUNT,
+};
+
+struct benchmark_result {
+	uint64_t p50_ns;
+	uint64_t p90_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+	uint64_t total_ns;
+};
+
+static const char * const operation_names[BENCHMARK_OPERATION_COUNT] = {
+	"aes128_ecb",
+	"cmac_aes128",
+	"setting_save",
+	"setting_load",
+	"setting_commit",
+};
+
+static const uint8_t benchmark_key[BENCHMARK_KEY_SIZE] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static uint8_t input[CONFIG_APP_BENCHMARK_CRYPTO_MAX_SIZE];
+static uint8_t output[CONFIG_APP_BENCHMARK_CRYPTO_MAX_SIZE];
+static uint32_t samples[CONFIG_APP_BENCHMARK_ITERATIONS];
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+static lorawan_aes_context local_aes_context;
+#elif defined(CONFIG_MBEDTLS_PSA_CRYPTO_C)
+static psa_key_id_t local_aes_key;
+static psa_key_id_t local_cmac_key;
+#endif
+
+#if defined(BENCHMARK_LOCAL)
+#if defined(CONFIG_MBEDTLS_PSA_CRYPTO_C) && !defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+static int local_import_key(psa_algorithm_t algorithm, psa_key_usage_t usage, psa_key_id_t *key_id)
+{
+	psa_key_attributes_t key_attributes = PSA_KEY_ATTRIBUTES_INIT;
+	psa_status_t status;
+
+	psa_set_key_usage_flags(&key_attributes, usage);
+	psa_set_key_algorithm(&key_attributes, algorithm);
+	psa_set_key_lifetime(&key_attributes, PSA_KEY_LIFETIME_VOLATILE);
+	psa_set_key_type(&key_attributes, PSA_KEY_TYPE_AES);
+	psa_set_key_bits(&key_attributes, 128);
+
+	status = psa_import_key(&key_attributes, benchmark_key, sizeof(benchmark_key), key_id);
+	psa_reset_key_attributes(&key_attributes);
+
+	return (status == PSA_SUCCESS ? 0 : -EIO);
+}
+#endif
+
+/* Keys are set up once, the same as the IPC crypto server keeps imported keys */
+static int local_setup(void)
+{
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+	lorawan_aes_set_key(benchmark_key, BENCHMARK_KEY_SIZE, &local_aes_context);
+
+	return 0;
+#else
+	int rc;
+
+	rc = local_import_key(PSA_ALG_ECB_NO_PADDING, PSA_KEY_USAGE_ENCRYPT, &local_aes_key);
+
+	if (rc == 0) {
+		rc = local_import_key(PSA_ALG_CMAC, PSA_KEY_USAGE_SIGN_MESSAGE, &local_cmac_key);
+	}
+
+	return rc;
+#endif
+}
+
+static int local_run(enum benchmark_operation operation, uint16_t size)
+{
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_CLIENT)
+	AES_CMAC_CTX aes_cmac_ctx;
+	uint16_t block;
+
+	if (operation == BENCHMARK_AES128_ECB) {
+		for (block = 0; block < size; block += 16) {
+			lorawan_aes_encrypt(&input[block], &output[block], &local_aes_context);
+		}
+	} else {
+		/* Init clears the key schedule so the prepared one is copied in afterwards */
+		AES_CMAC_Init(&aes_cmac_ctx);
+		memcpy(&aes_cmac_ctx.rijndael, &local_aes_context, sizeof(aes_cmac_ctx.rijndael));
+		AES_CMAC_Update(&aes_cmac_ctx, input, size);
+		AES_CMAC_Final(output, &aes_cmac_ctx);
+	}
+
+	return 0;
+#else
+	psa_status_t status;
+	size_t olen;
+
+	if (operation == BENCHMARK_AES128_ECB) {
+		status = psa_cipher_encrypt(local_aes_key, PSA_ALG_ECB_NO_PADDING, input, size, output,
+					    sizeof(output), &olen);
+	} else {
+		status = psa_mac_compute(local_cmac_key, PSA_ALG_CMAC, input, size, output,
+					 BENCHMARK_CMAC_SIZE, &olen);
+	}
+
+	return (status == PSA_SUCCESS ? 0 : -EIO);
+#endif
+}
+#endif
+
+static int ipc_run(enum benchmark_operation operation, uint16_t size)
+{
+	switch (operation) {
+	case BENCHMARK_AES128_ECB:
+		return ipc_lorawan_crypto_aes128_ecb_encrypt(BENCHMARK_KEY_ID, input, size, output);
+
+	case BENCHMARK_CMAC_AES128:
+		return ipc_lorawan_crypto_cmac_aes128_encrypt(BENCHMARK_KEY_ID, input, size, NULL, 0,
+							      output);
+
+	case BENCHMARK_SETTING_SAVE:
+		return ipc_setting_save((uint8_t *)BENCHMARK_SETTING_NAME, input, size);
+
+	case BENCHMARK_SETTING_LOAD:
+		return ipc_setting_load((uint8_t *)BENCHMARK_SETTING_NAME, output, size);
+
+	case BENCHMARK_SETTING_COMMIT:
+		return ipc_setting_commit();
+
+	default:
+		return -EINVAL;
+	}
+}
+
+static int sample_compare(const void *a, const void *b)
+{
+	uint32_t first = *(const uint32_t *)a;
+	uint32_t second = *(const uint32_t *)b;
+
+	return (first > second) - (first < second);
+}
+
+static uint64_t sample_percentile(uint8_t percentile)
+{
+	return BENCHMARK_CYCLES_TO_NS(samples[((ARRAY_SIZE(samples) - 1) * percentile) / 100]);
+}
+
+static int benchmark_measure(enum benchmark_operation operation, bool local, uint16_t size,
+			     struct benchmark_result *result)
+{
+	uint64_t total = 0;
+	uint32_t start;
+	uint32_t i;
+	int rc;
+
+	for (i = 0; i < ARRAY_SIZE(samples); ++i) {
+		start = BENCHMARK_CYCLES();
+
+#if defined(BENCHMARK_LOCAL)
+		if (local) {
+			rc = local_run(operation, size);
+		} else
+#endif
+		{
+			rc = ipc_run(operation, size);
+		}
+
+		samples[i] = BENCHMARK_CYCLES() - start;
+
+		if (rc < 0) {
+			LOG_ERR("%s (%u bytes) failed: %d", operation_names[operation], size, rc);
+			return rc;
+		}
+
+		total += samples[i];
+
+#if CONFIG_APP_BENCHMARK_INTERVAL_US > 0
+		{
+			uint64_t elapsed_us = BENCHMARK_CYCLES_TO_NS(samples[i]) / 1000;
+
+			if (elapsed_us < CONFIG_APP_BENCHMARK_INTERVAL_US) {
+				k_sleep(K_USEC(CONFIG_APP_BENCHMARK_INTERVAL_US - elapsed_us));
+			}
+		}
+#endif
+	}
+
+	qsort(samples, ARRAY_SIZE(samples), sizeof(samples[0]), sample_compare);
+
+	result->p50_ns = sample_percentile(50);
+	result->p90_ns = sample_percentile(90);
+	result->p99_ns = sample_percentile(99);
+	result->max_ns = BENCHMARK_CYCLES_TO_NS(samples[ARRAY_SIZE(samples) - 1]);
+	result->total_ns = BENCHMARK_CYCLES_TO_NS(total);
+
+	return 0;
+}
+
+static void benchmark_report(enum benchmark_operation operation, const char *path, uint16_t size,
+			     const struct benchmark_result *result)
+{
+	uint64_t total_ns = MAX(result->total_ns, 1);
+	uint64_t operations_per_second = ((uint64_t)ARRAY_SIZE(samples) * NSEC_PER_SEC) / total_ns;
+	uint64_t bytes_per_second = operations_per_second * size;
+
+	LOG_INF("%-14s %-7s %3u bytes: p50 %llu us, p90 %llu us, p99 %llu us, max %llu us, %llu op/s, %llu B/s",
+		operation_names[operation], path, size, result->p50_ns / 1000, result->p90_ns / 1000,
+		result->p99_ns / 1000, result->max_ns / 1000, operations_per_second,
+		bytes_per_second);
+
+	/* CSV for tracking: path,operation,size,p50_ns,p90_ns,p99_ns,max_ns,ops_per_second,bytes_per_second */
+	printk("bench,%s,%s,%u,%llu,%llu,%llu,%llu,%llu,%llu\n", path, operation_names[operation], size,
+	       result->p50_ns, result->p90_ns, result->p99_ns, result->max_ns,
+	       operations_per_second, bytes_per_second);
+}
+
+static int benchmark_operation(enum benchmark_operation operation, uint16_t size)
+{
+	struct benchmark_result result;
+	int rc;
+
+	rc = benchmark_measure(operation, false, size, &result);
+
+	if (rc < 0) {
+		return rc;
+	}
+
+	benchmark_report(operation, "ipc", size, &result);
+
+#if defined(BENCHMARK_LOCAL)
+	if (operation == BENCHMARK_AES128_ECB || operation == BENCHMARK_CMAC_AES128) {
+		rc = benchmark_measure(operation, true, size, &result);
+
+		if (rc < 0) {
+			return rc;
+		}
+
+		benchmark_report(operation, BENCHMARK_LOCAL, size, &result);
+	}
+#endif
+
+	return 0;
+}
+
+static int benchmark_run(void)
+{
+	uint16_t size;
+	int rc;
+
+	for (size = 0; size < sizeof(input); ++size) {
+		input[size] = (uint8_t)size;
+	}
+
+	rc = ipc_lorawan_crypto_set_key(BENCHMARK_KEY_ID, (uint8_t *)benchmark_key,
+					BENCHMARK_KEY_SIZE, TYPE_AES128);
+
+	if (rc == 0) {
+		rc = ipc_lorawan_crypto_set_key(BENCHMARK_KEY_ID, (uint8_t *)benchmark_key,
+						BENCHMARK_KEY_SIZE, TYPE_CMAC_AES128);
+	}
+
+	if (rc != 0) {
+		LOG_ERR("Set key failed: %d", rc);
+		return rc;
+	}
+
+#if defined(BENCHMARK_LOCAL)
+	rc = local_setup();
+
+	if (rc != 0) {
+		LOG_ERR("Local setup failed: %d", rc);
+		return rc;
+	}
+#endif
+
+	printk("bench,path,operation,size,p50_ns,p90_ns,p99_ns,max_ns,ops_per_second,bytes_per_second\n");
+
+	for (size = CONFIG_APP_BENCHMARK_CRYPTO_SIZE_STEP; size <= CONFIG_APP_BENCHMARK_CRYPTO_MAX_SIZE;
+	     size += CONFIG_APP_BENCHMARK_CRYPTO_SIZE_STEP) {
+		rc = benchmark_operation(BENCHMARK_AES128_ECB, size);
+
+		if (rc == 0) {
+			rc = benchmark_operation(BENCHMARK_CMAC_AES128, size);
+		}
+
+		if (rc < 0) {
+			return rc;
+		}
+	}
+
+	for (size = CONFIG_APP_BENCHMARK_SETTINGS_SIZE_STEP; size <= CONFIG_APP_BENCHMARK_SETTINGS_MAX_SIZE;
+	     size += CONFIG_APP_BENCHMARK_SETTINGS_SIZE_STEP) {
+		rc = benchmark_operation(BENCHMARK_SETTING_SAVE, size);
+
+		if (rc == 0) {
+			rc = benchmark_operation(BENCHMARK_SETTING_LOAD, size);
+		}
+
+		if (rc < 0) {
+			return rc;
+		}
+	}
+
+	return benchmark_operation(BENCHMARK_SETTING_COMMIT, 0);
+}
+
+int main(void)
+{
+	int rc;
+
+	rc = ipc_setup();
+
+	if (rc != 0) {
+		goto finish;
+	}
+
+	rc = ipc_wait_for_ready();
+
+	if (rc != 0) {
+		goto finish;
+	}
+
+	LOG_INF("Starting IPC benchmark, %u iterations, %u us interval",
+		CONFIG_APP_BENCHMARK_ITERATIONS, CONFIG_APP_BENCHMARK_INTERVAL_US);
+
+	rc = benchmark_run();
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK)
+	if (rc == 0) {
+		/* No MAC runs in this image, the secure element is only used by the benchmark */
+		static SecureElementNvmData_t se_nvm;
+
+		if (SecureElementInit(&se_nvm) != SECURE_ELEMENT_SUCCESS) {
+			rc = -EIO;
+		} else {
+			rc = soft_se_mod_benchmark();
+		}
+	}
+#endif
+
+	if (rc == 0) {
+		LOG_INF("Benchmark finished");
+	} else {
+		LOG_ERR("Benchmark failed: %d", rc);
+	}
+
+finish:
+#ifdef CONFIG_ARCH_POSIX
+	posix_exit(rc == 0 ? 0 : 1);
+#endif
+
+	return 0;
+}
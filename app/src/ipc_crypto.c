@@ -11,6 +11,7 @@
 #include <zephyr/logging/log.h>
 #include "ipc_endpoint.h"
 #include "ipc_crypto.h"
+#include "ipc_crypto_protocol.h"
 
 #if defined(CONFIG_IPC_LORAWAN_CRYPTO_SERVER)
 #elif defined(CONFIG_IPC_LORAWAN_CRYPTO_CLIENT)
@@ -21,49 +22,22 @@
 #include <psa/crypto_extra.h>
 #endif
 
+#define AES128_KEY_SIZE 16
 #define CMAC_AES128_SIZE 16
+#define RANDOM_MAX_SIZE 256
 
 LOG_MODULE_REGISTER(ipc_crypto, 4);
 
-struct ipc_lorawan_crypto_set_key_data {
-	uint8_t type;
-	uint16_t key_size;
-	uint8_t key[];
-};
-
-struct ipc_lorawan_crypto_set_key_response_data {
-	int rc;
-};
-
-struct ipc_lorawan_crypto_aes128_encrypt_data {
-	uint8_t key_id;
-	uint16_t data_size;
-	uint8_t data[];
-};
-
-struct ipc_lorawan_crypto_aes128_encrypt_response_data {
-	int rc;
-	uint16_t data_size;
-	uint8_t data[];
-};
-
-struct ipc_lorawan_crypto_cmac_aes128_verify_data {
-	uint8_t key_id;
-	uint16_t data_size;
-	uint16_t signature_size;
-	uint8_t data[]; //Data followed by signature
-};
-
-struct ipc_lorawan_crypto_cmac_aes128_verify_response_data {
-	int rc;
-};
-
 /* Client -> server */
 static int ipc_lorawan_crypto_callback_set_key(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_lorawan_crypto_callback_aes128_ecb_encrypt(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_lorawan_crypto_callback_aes128_ccm_encrypt(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_lorawan_crypto_callback_cmac_aes128_encrypt(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_lorawan_crypto_callback_cmac_aes128_verify(const uint8_t *message, uint16_t size, void *user_data);
+static int ipc_lorawan_crypto_callback_random(const uint8_t *message, uint16_t size, void *user_data);
+#if defined(CONFIG_IPC_LORAWAN_CRYPTO_SERVER)
+static int ipc_lorawan_crypto_callback_prepare(const uint8_t *message, uint16_t size, void *user_data);
+#endif
 
 #if defined(CONFIG_IPC_LORAWAN_CRYPTO_CLIENT)
 static struct {
@@ -74,6 +48,29 @@ static struct {
 	uint16_t load_size;
 } ipc_lorawan_crypto_data;
 
+/* Entropy pool, read index is head and bytes available is level */
+static struct {
+	struct k_spinlock lock;
+	struct k_work refill;
+	uint16_t head;
+	uint16_t level;
+	uint8_t pool[CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_SIZE];
+} ipc_lorawan_crypto_random_pool;
+
+BUILD_ASSERT(CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_THRESHOLD <
+	     CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_SIZE,
+	     "Random pool threshold must be smaller than the pool");
+
+/* Refills wait for IPC responses, they are run on their own queue so that they do not hold up
+ * the system work queue
+ */
+static struct k_work_q ipc_lorawan_crypto_random_work_q;
+static K_THREAD_STACK_DEFINE(ipc_lorawan_crypto_random_stack,
+			     CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_STACK_SIZE);
+static const struct k_work_queue_config ipc_lorawan_crypto_random_work_q_config = {
+	.name = "ipc_random",
+};
+
 static struct ipc_group ipc_group_set_key = {
 	.callback = ipc_lorawan_crypto_callback_set_key,
 	.opcode = IPC_OPCODE_CRYPTO_SET_KEY,
@@ -103,6 +100,12 @@ static struct ipc_group ipc_group_cmac_aes128_verify = {
 	.opcode = IPC_OPCODE_CRYPTO_CMAC_AES128_VERIFY,
 	.user_data = &ipc_lorawan_crypto_data,
 };
+
+static struct ipc_group ipc_group_random = {
+	.callback = ipc_lorawan_crypto_callback_random,
+	.opcode = IPC_OPCODE_CRYPTO_RANDOM,
+	.user_data = &ipc_lorawan_crypto_data,
+};
 #endif
 
 #if defined(CONFIG_IPC_LORAWAN_CRYPTO_SERVER)
@@ -130,83 +133,255 @@ static struct ipc_group ipc_group_cmac_aes128_verify = {
 	.callback = ipc_lorawan_crypto_callback_cmac_aes128_verify,
 	.opcode = IPC_OPCODE_CRYPTO_CMAC_AES128_VERIFY,
 };
+
+static struct ipc_group ipc_group_random = {
+	.callback = ipc_lorawan_crypto_callback_random,
+	.opcode = IPC_OPCODE_CRYPTO_RANDOM,
+};
+
+static struct ipc_group ipc_group_prepare = {
+	.callback = ipc_lorawan_crypto_callback_prepare,
+	.opcode = IPC_OPCODE_CRYPTO_PREPARE,
+};
 #endif
 
 #if defined(CONFIG_IPC_LORAWAN_CRYPTO_SERVER)
-static psa_key_id_t magic_key_id;
+/*
+ * Imported keys are kept in slots so that a key is only imported again when the client changes
+ * it. A slot can have its operation set up ahead of time by a prepare request (primed) so that
+ * a following request only has to do the update and finish steps.
+ */
+struct ipc_lorawan_crypto_key_slot {
+	psa_key_id_t psa_key_id;
+	uint8_t key_id;
+	uint8_t type;
+	bool primed;
+	uint32_t last_used;
+	uint8_t key[AES128_KEY_SIZE];
+	union {
+		psa_cipher_operation_t cipher;
+		psa_mac_operation_t mac;
+	} operation;
+};
+
+static struct ipc_lorawan_crypto_key_slot key_slots[CONFIG_IPC_LORAWAN_CRYPTO_KEY_SLOTS];
+static uint32_t key_slot_counter;
 
-static int encrypt_aes128(psa_key_id_t *key_id, uint8_t mode, uint8_t *data, uint16_t data_size, uint8_t *encrypted_data)
+static struct ipc_lorawan_crypto_key_slot *key_slot_find(uint8_t key_id, uint8_t type)
+{
+	for (uint8_t i = 0; i < ARRAY_SIZE(key_slots); i++) {
+		if (key_slots[i].psa_key_id != PSA_KEY_ID_NULL && key_slots[i].key_id == key_id &&
+		    key_slots[i].type == type) {
+			key_slots[i].last_used = ++key_slot_counter;
+			return &key_slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void key_slot_release(struct ipc_lorawan_crypto_key_slot *slot)
+{
+	psa_status_t status;
+
+	if (slot->primed) {
+		if (slot->type == TYPE_AES128) {
+			(void)psa_cipher_abort(&slot->operation.cipher);
+		} else {
+			(void)psa_mac_abort(&slot->operation.mac);
+		}
+
+		slot->primed = false;
+	}
+
+	if (slot->psa_key_id != PSA_KEY_ID_NULL) {
+		status = psa_destroy_key(slot->psa_key_id);
+
+		if (status != PSA_SUCCESS) {
+			LOG_ERR("Key removal failed: %d", status);
+		}
+
+		slot->psa_key_id = PSA_KEY_ID_NULL;
+	}
+
+	memset(slot->key, 0, sizeof(slot->key));
+}
+
+//TODO: this function is temporary and needs removing when KMU is used
+static int key_slot_import(uint8_t key_id, uint8_t type, const uint8_t *key, uint16_t key_size,
+			   struct ipc_lorawan_crypto_key_slot **imported_slot)
+{
+	struct ipc_lorawan_crypto_key_slot *slot;
+	psa_status_t status;
+	psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+
+	if (key_size != AES128_KEY_SIZE || (type != TYPE_AES128 && type != TYPE_CMAC_AES128)) {
+		return -EINVAL;
+	}
+
+	slot = key_slot_find(key_id, type);
+
+	if (slot != NULL && memcmp(slot->key, key, key_size) == 0) {
+		/* Already loaded */
+		goto finish;
+	}
+
+	if (slot == NULL) {
+		slot = &key_slots[0];
+
+		for (uint8_t i = 0; i < ARRAY_SIZE(key_slots); i++) {
+			if (key_slots[i].psa_key_id == PSA_KEY_ID_NULL) {
+				slot = &key_slots[i];
+				break;
+			}
+
+			if (key_slots[i].last_used < slot->last_used) {
+				slot = &key_slots[i];
+			}
+		}
+	}
+
+	key_slot_release(slot);
+
+	if (type == TYPE_AES128) {
+		psa_set_key_usage_flags(&attributes, (PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT));
+		psa_set_key_algorithm(&attributes, PSA_ALG_ECB_NO_PADDING);
+	} else {
+		psa_set_key_usage_flags(&attributes, (PSA_KEY_USAGE_VERIFY_HASH | PSA_KEY_USAGE_SIGN_HASH));
+		psa_set_key_algorithm(&attributes, PSA_ALG_CMAC);
+	}
+
+	psa_set_key_lifetime(&attributes, PSA_KEY_LIFETIME_VOLATILE);
+	psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
+	psa_set_key_bits(&attributes, 128);
+	status = psa_import_key(&attributes, key, key_size, &slot->psa_key_id);
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Key import failed: %d", status);
+		slot->psa_key_id = PSA_KEY_ID_NULL;
+		return -EINVAL;
+	}
+
+	slot->key_id = key_id;
+	slot->type = type;
+	slot->last_used = ++key_slot_counter;
+	memcpy(slot->key, key, key_size);
+
+finish:
+	if (imported_slot != NULL) {
+		*imported_slot = slot;
+	}
+
+	return 0;
+}
+
+static int key_slot_prime(struct ipc_lorawan_crypto_key_slot *slot)
 {
-	/* ECB at present */
-	uint32_t output_size;
 	psa_status_t status;
-	psa_cipher_operation_t operation = PSA_CIPHER_OPERATION_INIT;
 
-	status = psa_cipher_encrypt_setup(&operation, *key_id, PSA_ALG_ECB_NO_PADDING);
+	if (slot->primed) {
+		return 0;
+	}
+
+	if (slot->type == TYPE_AES128) {
+		status = psa_cipher_encrypt_setup(&slot->operation.cipher, slot->psa_key_id,
+						  PSA_ALG_ECB_NO_PADDING);
+	} else {
+		status = psa_mac_sign_setup(&slot->operation.mac, slot->psa_key_id, PSA_ALG_CMAC);
+	}
 
 	if (status != PSA_SUCCESS) {
-		LOG_ERR("AES128 ECB setup failed: %d", status);
+		LOG_ERR("Key slot prime failed: %d", status);
 		return -EINVAL;
 	}
 
-	status = psa_cipher_update(&operation, data, data_size, encrypted_data, data_size, &output_size);
+	slot->primed = true;
+
+	return 0;
+}
+
+static int encrypt_aes128(struct ipc_lorawan_crypto_key_slot *slot, uint8_t mode, uint8_t *data, uint16_t data_size, uint8_t *encrypted_data)
+{
+	/* ECB at present */
+	uint32_t output_size;
+	psa_status_t status;
+	psa_cipher_operation_t *operation = &slot->operation.cipher;
+
+	if (!slot->primed) {
+		status = psa_cipher_encrypt_setup(operation, slot->psa_key_id, PSA_ALG_ECB_NO_PADDING);
+
+		if (status != PSA_SUCCESS) {
+			LOG_ERR("AES128 ECB setup failed: %d", status);
+			return -EINVAL;
+		}
+	}
+
+	/* Operation is consumed by this request whether it succeeds or not */
+	slot->primed = false;
+
+	status = psa_cipher_update(operation, data, data_size, encrypted_data, data_size, &output_size);
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("AES128 ECB update failed: %d", status);
+		psa_cipher_abort(operation);
 		return -EINVAL;
 	}
 
-	status = psa_cipher_finish(&operation, (encrypted_data + output_size), (data_size - output_size), &output_size);
+	status = psa_cipher_finish(operation, (encrypted_data + output_size), (data_size - output_size), &output_size);
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("AES128 ECB finish failed: %d", status);
+		psa_cipher_abort(operation);
 		return -EINVAL;
 	}
 
-LOG_HEXDUMP_ERR(data, data_size, "in");
-LOG_HEXDUMP_ERR(encrypted_data, data_size, "out");
-
-	psa_cipher_abort(&operation);
+	psa_cipher_abort(operation);
 
 	return 0;
 }
 
-static int encrypt_cmac_aes128(psa_key_id_t *key_id, uint8_t *data, uint16_t data_size, uint8_t *cmac, uint16_t cmac_size)
+static int encrypt_cmac_aes128(struct ipc_lorawan_crypto_key_slot *slot, uint8_t *data, uint16_t data_size, uint8_t *cmac, uint16_t cmac_size)
 {
 	uint32_t output_size;
 	psa_status_t status;
-	psa_mac_operation_t operation = PSA_MAC_OPERATION_INIT;
+	psa_mac_operation_t *operation = &slot->operation.mac;
 
-	status = psa_mac_sign_setup(&operation, *key_id, PSA_ALG_CMAC);
+	if (!slot->primed) {
+		status = psa_mac_sign_setup(operation, slot->psa_key_id, PSA_ALG_CMAC);
 
-	if (status != PSA_SUCCESS) {
-		LOG_ERR("CMAC AES128 setup failed: %d", status);
-		return -EINVAL;
+		if (status != PSA_SUCCESS) {
+			LOG_ERR("CMAC AES128 setup failed: %d", status);
+			return -EINVAL;
+		}
 	}
 
-	status = psa_mac_update(&operation, data, data_size);
+	slot->primed = false;
+
+	status = psa_mac_update(operation, data, data_size);
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("CMAC AES128 update failed: %d", status);
+		psa_mac_abort(operation);
 		return -EINVAL;
 	}
 
-	status = psa_mac_sign_finish(&operation, cmac, cmac_size, &output_size);
+	status = psa_mac_sign_finish(operation, cmac, cmac_size, &output_size);
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("CMAC AES128 finish failed: %d", status);
+		psa_mac_abort(operation);
 		return -EINVAL;
 	}
 
 	return 0;
 }
 
-static int verify_cmac_aes128(psa_key_id_t *key_id, uint8_t *data, uint16_t data_size, uint8_t *cmac, uint16_t cmac_size)
+static int verify_cmac_aes128(struct ipc_lorawan_crypto_key_slot *slot, uint8_t *data, uint16_t data_size, uint8_t *cmac, uint16_t cmac_size)
 {
 	psa_status_t status;
 	psa_mac_operation_t operation = PSA_MAC_OPERATION_INIT;
 
-	status = psa_mac_verify_setup(&operation, *key_id, PSA_ALG_CMAC);
+	status = psa_mac_verify_setup(&operation, slot->psa_key_id, PSA_ALG_CMAC);
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("CMAC AES128 setup failed: %d", status);
@@ -217,6 +392,7 @@ static int verify_cmac_aes128(psa_key_id_t *key_id, uint8_t *data, uint16_t data
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("CMAC AES128 update failed: %d", status);
+		psa_mac_abort(&operation);
 		return -EINVAL;
 	}
 
@@ -224,58 +400,20 @@ static int verify_cmac_aes128(psa_key_id_t *key_id, uint8_t *data, uint16_t data
 
 	if (status != PSA_SUCCESS) {
 		LOG_ERR("CMAC AES128 verify failed: %d", status);
+		psa_mac_abort(&operation);
 		return -EBADMSG;
 	}
 
 	return 0;
 }
 
-//TODO: this function is temporary and needs removing when KMU is used
-static int crypto_cleanup(psa_key_id_t *key_id)
-{
-	psa_status_t status;
-
-	status = psa_destroy_key(*key_id);
-
-	if (status != PSA_SUCCESS) {
-		LOG_ERR("Key removal failed: %d", status);
-		return -EINVAL;
-	}
-
-	return 0;
-}
-
-//TODO: this function is temporary and needs removing when KMU is used
 static int ipc_lorawan_crypto_callback_set_key(const uint8_t *message, uint16_t size, void *user_data)
 {
 	int rc;
 	struct ipc_lorawan_crypto_set_key_data *setting = (struct ipc_lorawan_crypto_set_key_data *)message;
 	struct ipc_lorawan_crypto_set_key_response_data data;
-	psa_status_t status;
-	psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
-
-	if (setting->type == TYPE_AES128) {
-		psa_set_key_usage_flags(&attributes, (PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT));
-		psa_set_key_algorithm(&attributes, PSA_ALG_ECB_NO_PADDING);
-	} else if (setting->type == TYPE_CMAC_AES128) {
-		psa_set_key_usage_flags(&attributes, (PSA_KEY_USAGE_VERIFY_HASH | PSA_KEY_USAGE_SIGN_HASH));
-		psa_set_key_algorithm(&attributes, PSA_ALG_CMAC);
-	}
-
-//LOG_HEXDUMP_ERR(setting->key, setting->key_size, "key");
-//LOG_HEXDUMP_ERR(message, size, "key");
-
-	psa_set_key_lifetime(&attributes, PSA_KEY_LIFETIME_VOLATILE);
-	psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
-	psa_set_key_bits(&attributes, 128);
-	status = psa_import_key(&attributes, setting->key, setting->key_size, &magic_key_id);
 
-	if (status != PSA_SUCCESS) {
-		LOG_ERR("Key import failed: %d", status);
-		data.rc = -EINVAL;
-	} else {
-		data.rc = 0;
-	}
+	data.rc = key_slot_import(setting->key_id, setting->type, setting->key, setting->key_size, NULL);
 
 	rc = ipc_send_message(IPC_OPCODE_CRYPTO_SET_KEY, sizeof(data), (uint8_t *)&data);
 
@@ -285,23 +423,22 @@ static int ipc_lorawan_crypto_callback_set_key(const uint8_t *message, uint16_t
 static int ipc_lorawan_crypto_callback_aes128_ecb_encrypt(const uint8_t *message, uint16_t size, void *user_data)
 {
 	int rc;
-	int rc_cleanup;
 	struct ipc_lorawan_crypto_aes128_encrypt_data *setting = (struct ipc_lorawan_crypto_aes128_encrypt_data *)message;
 	struct ipc_lorawan_crypto_aes128_encrypt_response_data *data;
+	struct ipc_lorawan_crypto_key_slot *slot = key_slot_find(setting->key_id, TYPE_AES128);
 	uint16_t total_size = sizeof(struct ipc_lorawan_crypto_aes128_encrypt_response_data) + setting->data_size;
 
 	data = (struct ipc_lorawan_crypto_aes128_encrypt_response_data *)malloc(total_size);
 
-	rc = encrypt_aes128(&magic_key_id, 0, setting->data, setting->data_size, data->data);
-	data->rc = rc;
-LOG_ERR("encrypt: %d", rc);
-
-	if (rc == 0) {
-		data->data_size = setting->data_size;
+	if (slot == NULL) {
+		/* Key was evicted or never set, client has to send it again */
+		rc = -ENOKEY;
+	} else {
+		rc = encrypt_aes128(slot, 0, setting->data, setting->data_size, data->data);
 	}
 
-	rc_cleanup = crypto_cleanup(&magic_key_id);
-LOG_ERR("finish: %d", rc_cleanup);
+	data->rc = rc;
+	data->data_size = (rc == 0 ? setting->data_size : 0);
 
 	rc = ipc_send_message(IPC_OPCODE_CRYPTO_AES128_ECB_ENCRYPT, total_size, (uint8_t *)data);
 	free(data);
@@ -315,8 +452,7 @@ static int ipc_lorawan_crypto_callback_aes128_ccm_encrypt(const uint8_t *message
 	struct ipc_lorawan_crypto_aes128_encrypt_data *setting = (struct ipc_lorawan_crypto_aes128_encrypt_data *)message;
 	struct ipc_lorawan_crypto_aes128_encrypt_response_data data;
 
-LOG_ERR("abc1: %d", rc);
-data.rc = rc;
+	data.rc = rc;
 
 	rc = ipc_send_message(IPC_OPCODE_CRYPTO_AES128_CCM_ENCRYPT, sizeof(data), (uint8_t *)&data);
 
@@ -326,24 +462,24 @@ data.rc = rc;
 static int ipc_lorawan_crypto_callback_cmac_aes128_encrypt(const uint8_t *message, uint16_t size, void *user_data)
 {
 	int rc;
-	int rc_cleanup;
 	struct ipc_lorawan_crypto_aes128_encrypt_data *setting = (struct ipc_lorawan_crypto_aes128_encrypt_data *)message;
 	struct ipc_lorawan_crypto_aes128_encrypt_response_data *data;
+	struct ipc_lorawan_crypto_key_slot *slot = key_slot_find(setting->key_id, TYPE_CMAC_AES128);
 	uint16_t total_size = sizeof(struct ipc_lorawan_crypto_aes128_encrypt_response_data) + CMAC_AES128_SIZE;
 
 	data = (struct ipc_lorawan_crypto_aes128_encrypt_response_data *)malloc(total_size);
 
-	rc = encrypt_cmac_aes128(&magic_key_id, setting->data, setting->data_size, data->data, CMAC_AES128_SIZE);
-	data->rc = rc;
-
-	if (rc == 0) {
-		data->data_size = CMAC_AES128_SIZE;
+	if (slot == NULL) {
+		rc = -ENOKEY;
+	} else {
+		rc = encrypt_cmac_aes128(slot, setting->data, setting->data_size, data->data, CMAC_AES128_SIZE);
 	}
 
-	rc_cleanup = crypto_cleanup(&magic_key_id);
-LOG_ERR("finish: %d", rc_cleanup);
+	data->rc = rc;
+	data->data_size = (rc == 0 ? CMAC_AES128_SIZE : 0);
 
 	rc = ipc_send_message(IPC_OPCODE_CRYPTO_CMAC_AES128_ENCRYPT, total_size, (uint8_t *)data);
+	free(data);
 
 	return rc;
 }
@@ -351,21 +487,101 @@ LOG_ERR("finish: %d", rc_cleanup);
 static int ipc_lorawan_crypto_callback_cmac_aes128_verify(const uint8_t *message, uint16_t size, void *user_data)
 {
 	int rc;
-	int rc_cleanup;
 	struct ipc_lorawan_crypto_cmac_aes128_verify_data *setting = (struct ipc_lorawan_crypto_cmac_aes128_verify_data *)message;
 	struct ipc_lorawan_crypto_cmac_aes128_verify_response_data data;
+	struct ipc_lorawan_crypto_key_slot *slot = key_slot_find(setting->key_id, TYPE_CMAC_AES128);
 
-	rc = verify_cmac_aes128(&magic_key_id, setting->data, setting->data_size, &setting->data[setting->data_size], setting->signature_size);
-	data.rc = rc;
-LOG_ERR("cmac verify: %d", rc);
+	if (slot == NULL) {
+		rc = -ENOKEY;
+	} else {
+		rc = verify_cmac_aes128(slot, setting->data, setting->data_size, &setting->data[setting->data_size], setting->signature_size);
+	}
 
-	rc_cleanup = crypto_cleanup(&magic_key_id);
-LOG_ERR("finish: %d", rc_cleanup);
+	data.rc = rc;
 
 	rc = ipc_send_message(IPC_OPCODE_CRYPTO_CMAC_AES128_VERIFY, sizeof(data), (uint8_t *)&data);
 
 	return rc;
 }
+
+static int ipc_lorawan_crypto_callback_prepare(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_lorawan_crypto_prepare_data *setting = (struct ipc_lorawan_crypto_prepare_data *)message;
+
+	if (size < sizeof(struct ipc_lorawan_crypto_prepare_data) ||
+	    size < (sizeof(struct ipc_lorawan_crypto_prepare_data) +
+		    setting->key_count * sizeof(struct ipc_lorawan_crypto_key))) {
+		return -EINVAL;
+	}
+
+	/* Hint only, there is no response so failures are just logged */
+	for (uint8_t i = 0; i < setting->key_count; i++) {
+		struct ipc_lorawan_crypto_key *key = &setting->keys[i];
+		struct ipc_lorawan_crypto_key_slot *slot;
+		int rc;
+
+		rc = key_slot_import(key->key_id, key->type, key->key, sizeof(key->key), &slot);
+
+		if (rc == 0) {
+			rc = key_slot_prime(slot);
+		}
+
+		if (rc != 0) {
+			LOG_ERR("Prepare of key %d failed: %d", key->key_id, rc);
+		}
+	}
+
+	return 0;
+}
+
+static int ipc_lorawan_crypto_callback_random(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_lorawan_crypto_random_data *setting = (struct ipc_lorawan_crypto_random_data *)message;
+	struct ipc_lorawan_crypto_random_response_data *data = NULL;
+	uint16_t data_size;
+	uint16_t total_size;
+	psa_status_t status;
+	struct ipc_lorawan_crypto_random_response_data error_data = {
+		.rc = -EINVAL,
+		.data_size = 0,
+	};
+
+	if (size < sizeof(struct ipc_lorawan_crypto_random_data)) {
+		/* The client waits for a response, so a malformed request is answered */
+		goto error;
+	}
+
+	data_size = MIN(setting->data_size, RANDOM_MAX_SIZE);
+	total_size = sizeof(struct ipc_lorawan_crypto_random_response_data) + data_size;
+	data = (struct ipc_lorawan_crypto_random_response_data *)malloc(total_size);
+
+	if (data == NULL) {
+		error_data.rc = -ENOMEM;
+		goto error;
+	}
+
+	/* Whole batch comes from the CRACEN DRBG in one go, the client pools it */
+	status = psa_generate_random(data->data, data_size);
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Random generation failed: %d", status);
+		data->rc = -EIO;
+		data->data_size = 0;
+		total_size = sizeof(struct ipc_lorawan_crypto_random_response_data);
+	} else {
+		data->rc = 0;
+		data->data_size = data_size;
+	}
+
+	rc = ipc_send_message(IPC_OPCODE_CRYPTO_RANDOM, total_size, (uint8_t *)data);
+	free(data);
+
+	return rc;
+
+error:
+	return ipc_send_message(IPC_OPCODE_CRYPTO_RANDOM, sizeof(error_data), (uint8_t *)&error_data);
+}
 #endif
 
 #if defined(CONFIG_IPC_LORAWAN_CRYPTO_CLIENT)
@@ -375,7 +591,6 @@ static int ipc_lorawan_crypto_callback_set_key(const uint8_t *message, uint16_t
 	struct ipc_lorawan_crypto_set_key_response_data *data = (struct ipc_lorawan_crypto_set_key_response_data *)message;
 
 	ipc_lorawan_crypto_data.rc = data->rc;
-LOG_ERR("abc4: %d", data->rc);
 
 	k_sem_give(&ipc_lorawan_crypto_data.done);
 
@@ -388,7 +603,6 @@ static int ipc_lorawan_crypto_callback_aes128_ecb_encrypt(const uint8_t *message
 	struct ipc_lorawan_crypto_aes128_encrypt_response_data *data = (struct ipc_lorawan_crypto_aes128_encrypt_response_data *)message;
 
 //check length/null
-LOG_ERR("rc1? %d, len? %d, ", data->rc, data->data_size);
 //LOG_HEXDUMP_ERR(data->data, data->data_size, "tmp");
 	if (data->rc == 0) {
 //LOG_ERR("move to %p", ipc_lorawan_crypto_data.load_pointer);
@@ -424,7 +638,6 @@ static int ipc_lorawan_crypto_callback_cmac_aes128_encrypt(const uint8_t *messag
 	struct ipc_lorawan_crypto_aes128_encrypt_response_data *data = (struct ipc_lorawan_crypto_aes128_encrypt_response_data *)message;
 
 //check length/null
-LOG_ERR("rc2? %d, len? %d, ", data->rc, data->data_size);
 //LOG_HEXDUMP_ERR(data->data, data->data_size, "tmp");
 	if (data->rc == 0) {
 		memcpy(ipc_lorawan_crypto_data.load_pointer, data->data, data->data_size);
@@ -446,14 +659,31 @@ static int ipc_lorawan_crypto_callback_cmac_aes128_verify(const uint8_t *message
 	struct ipc_lorawan_crypto_cmac_aes128_verify_response_data *data = (struct ipc_lorawan_crypto_cmac_aes128_verify_response_data *)message;
 
 	ipc_lorawan_crypto_data.rc = data->rc;
-LOG_ERR("abc8: %d", data->rc);
 
 	k_sem_give(&ipc_lorawan_crypto_data.done);
 
 	return 0;
 }
 
-int ipc_lorawan_crypto_set_key(uint8_t *key, uint16_t key_size, uint8_t usage)
+static int ipc_lorawan_crypto_callback_random(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_lorawan_crypto_random_response_data *data = (struct ipc_lorawan_crypto_random_response_data *)message;
+
+	if (data->rc == 0 && ipc_lorawan_crypto_data.load_pointer != NULL) {
+		memcpy(ipc_lorawan_crypto_data.load_pointer, data->data,
+		       MIN(data->data_size, ipc_lorawan_crypto_data.load_size));
+	}
+
+	ipc_lorawan_crypto_data.load_pointer = NULL;
+	ipc_lorawan_crypto_data.load_size = data->data_size;
+	ipc_lorawan_crypto_data.rc = data->rc;
+
+	k_sem_give(&ipc_lorawan_crypto_data.done);
+
+	return 0;
+}
+
+int ipc_lorawan_crypto_set_key(uint8_t key_id, uint8_t *key, uint16_t key_size, uint8_t usage)
 {
 	int rc;
 	struct ipc_lorawan_crypto_set_key_data *data;
@@ -463,6 +693,7 @@ int ipc_lorawan_crypto_set_key(uint8_t *key, uint16_t key_size, uint8_t usage)
 
 	data = (struct ipc_lorawan_crypto_set_key_data *)malloc(total_size);
 	data->type = usage;
+	data->key_id = key_id;
 	data->key_size = key_size;
 	memcpy(data->key, key, key_size);
 
@@ -565,6 +796,153 @@ finish:
 	k_sem_give(&ipc_lorawan_crypto_data.busy);
 	return rc;
 }
+
+int ipc_lorawan_crypto_prepare(const struct ipc_lorawan_crypto_key *keys, uint8_t key_count)
+{
+	int rc;
+	struct ipc_lorawan_crypto_prepare_data *data;
+	uint16_t total_size = sizeof(struct ipc_lorawan_crypto_prepare_data) + key_count * sizeof(struct ipc_lorawan_crypto_key);
+
+	data = (struct ipc_lorawan_crypto_prepare_data *)malloc(total_size);
+
+	if (data == NULL) {
+		return -ENOMEM;
+	}
+
+	data->key_count = key_count;
+	memcpy(data->keys, keys, key_count * sizeof(struct ipc_lorawan_crypto_key));
+
+	/* No response is sent for a hint, only serialise with other requests */
+	rc = k_sem_take(&ipc_lorawan_crypto_data.busy, K_FOREVER);
+	rc = ipc_send_message(IPC_OPCODE_CRYPTO_PREPARE, total_size, (uint8_t *)data);
+	k_sem_give(&ipc_lorawan_crypto_data.busy);
+
+	memset(data, 0, total_size);
+	free(data);
+
+	return (rc < 0 ? rc : 0);
+}
+
+int ipc_lorawan_crypto_random(uint8_t *data, uint16_t data_size)
+{
+	int rc;
+	struct ipc_lorawan_crypto_random_data internal_data = {
+		.data_size = data_size,
+	};
+
+	if (data_size > RANDOM_MAX_SIZE) {
+		return -EINVAL;
+	}
+
+	rc = k_sem_take(&ipc_lorawan_crypto_data.busy, K_FOREVER);
+
+	ipc_lorawan_crypto_data.load_pointer = data;
+	ipc_lorawan_crypto_data.load_size = data_size;
+
+	rc = ipc_send_message(IPC_OPCODE_CRYPTO_RANDOM, sizeof(internal_data), (uint8_t *)&internal_data);
+
+	if (rc < 0) {
+		goto finish;
+	}
+
+	rc = k_sem_take(&ipc_lorawan_crypto_data.done, K_FOREVER);
+
+	if (rc == 0) {
+		rc = ipc_lorawan_crypto_data.rc;
+	}
+
+	if (rc == 0 && ipc_lorawan_crypto_data.load_size != data_size) {
+		rc = -EIO;
+	}
+
+finish:
+	k_sem_give(&ipc_lorawan_crypto_data.busy);
+	return rc;
+}
+
+static void ipc_lorawan_crypto_random_refill_handler(struct k_work *work)
+{
+	int rc;
+	uint8_t batch[CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_REFILL_SIZE];
+	k_spinlock_key_t key;
+
+	while (1) {
+		uint16_t free_space;
+		uint16_t batch_size;
+		uint16_t tail;
+
+		key = k_spin_lock(&ipc_lorawan_crypto_random_pool.lock);
+		free_space = sizeof(ipc_lorawan_crypto_random_pool.pool) -
+			     ipc_lorawan_crypto_random_pool.level;
+		k_spin_unlock(&ipc_lorawan_crypto_random_pool.lock, key);
+
+		if (free_space == 0) {
+			break;
+		}
+
+		batch_size = MIN(free_space, sizeof(batch));
+		rc = ipc_lorawan_crypto_random(batch, batch_size);
+
+		if (rc != 0) {
+			LOG_ERR("Random pool refill failed: %d", rc);
+			break;
+		}
+
+		/* Only this work item adds to the pool so free space cannot have shrunk */
+		key = k_spin_lock(&ipc_lorawan_crypto_random_pool.lock);
+		tail = (ipc_lorawan_crypto_random_pool.head + ipc_lorawan_crypto_random_pool.level) %
+		       sizeof(ipc_lorawan_crypto_random_pool.pool);
+
+		for (uint16_t i = 0; i < batch_size; i++) {
+			ipc_lorawan_crypto_random_pool.pool[tail] = batch[i];
+			tail = (tail + 1) % sizeof(ipc_lorawan_crypto_random_pool.pool);
+		}
+
+		ipc_lorawan_crypto_random_pool.level += batch_size;
+		k_spin_unlock(&ipc_lorawan_crypto_random_pool.lock, key);
+	}
+
+	memset(batch, 0, sizeof(batch));
+}
+
+void ipc_lorawan_crypto_random_pool_refill(void)
+{
+	(void)k_work_submit_to_queue(&ipc_lorawan_crypto_random_work_q,
+				     &ipc_lorawan_crypto_random_pool.refill);
+}
+
+int ipc_lorawan_crypto_random_get(uint8_t *data, uint16_t data_size)
+{
+	int rc = 0;
+	bool refill;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&ipc_lorawan_crypto_random_pool.lock);
+
+	if (ipc_lorawan_crypto_random_pool.level < data_size) {
+		rc = -EAGAIN;
+	} else {
+		for (uint16_t i = 0; i < data_size; i++) {
+			/* Clear consumed bytes so that a value is never handed out twice */
+			data[i] = ipc_lorawan_crypto_random_pool.pool[ipc_lorawan_crypto_random_pool.head];
+			ipc_lorawan_crypto_random_pool.pool[ipc_lorawan_crypto_random_pool.head] = 0;
+			ipc_lorawan_crypto_random_pool.head = (ipc_lorawan_crypto_random_pool.head + 1) %
+							      sizeof(ipc_lorawan_crypto_random_pool.pool);
+		}
+
+		ipc_lorawan_crypto_random_pool.level -= data_size;
+	}
+
+	refill = (ipc_lorawan_crypto_random_pool.level <
+		  CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_THRESHOLD);
+	k_spin_unlock(&ipc_lorawan_crypto_random_pool.lock, key);
+
+	if (refill) {
+		ipc_lorawan_crypto_random_pool_refill();
+	}
+
+	return rc;
+}
 #endif
 
 static int ipc_lorawan_crypto_register(void)
@@ -574,6 +952,12 @@ static int ipc_lorawan_crypto_register(void)
 	k_sem_init(&ipc_lorawan_crypto_data.done, 0, 1);
 	ipc_lorawan_crypto_data.load_pointer = NULL;
 	ipc_lorawan_crypto_data.load_size = 0;
+	k_work_init(&ipc_lorawan_crypto_random_pool.refill, ipc_lorawan_crypto_random_refill_handler);
+	k_work_queue_init(&ipc_lorawan_crypto_random_work_q);
+	k_work_queue_start(&ipc_lorawan_crypto_random_work_q, ipc_lorawan_crypto_random_stack,
+			   K_THREAD_STACK_SIZEOF(ipc_lorawan_crypto_random_stack),
+			   CONFIG_IPC_LORAWAN_CRYPTO_RANDOM_POOL_THREAD_PRIORITY,
+			   &ipc_lorawan_crypto_random_work_q_config);
 #endif
 
 	ipc_register(&ipc_group_set_key);
@@ -581,6 +965,10 @@ static int ipc_lorawan_crypto_register(void)
 	ipc_register(&ipc_group_aes128_ccm_encrypt);
 	ipc_register(&ipc_group_cmac_aes128_encrypt);
 	ipc_register(&ipc_group_cmac_aes128_verify);
+	ipc_register(&ipc_group_random);
+#if defined(CONFIG_IPC_LORAWAN_CRYPTO_SERVER)
+	ipc_register(&ipc_group_prepare);
+#endif
 
 	return 0;
 }
@@ -4,6 +4,9 @@
  * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
  */
 
+#ifndef APP_IPC_CRYPTO_H
+#define APP_IPC_CRYPTO_H
+
 #include <stdint.h>
 
 enum usage_type {
@@ -11,6 +14,18 @@ enum usage_type {
 	TYPE_CMAC_AES128,
 };
 
-int ipc_lorawan_crypto_set_key(uint8_t *key, uint16_t key_size, uint8_t usage);
+struct ipc_lorawan_crypto_key {
+	uint8_t key_id;
+	uint8_t type;
+	uint8_t key[16];
+};
+
+int ipc_lorawan_crypto_set_key(uint8_t key_id, uint8_t *key, uint16_t key_size, uint8_t usage);
 int ipc_lorawan_crypto_aes128_ecb_encrypt(uint8_t key_id, uint8_t *data, uint16_t data_size, uint8_t *encrypted_data);
 int ipc_lorawan_crypto_cmac_aes128_encrypt(uint8_t key_id, uint8_t *data, uint16_t data_size, uint8_t *prior_data, uint16_t prior_data_size, uint8_t *encrypted_data);
+int ipc_lorawan_crypto_random(uint8_t *data, uint16_t data_size);
+int ipc_lorawan_crypto_random_get(uint8_t *data, uint16_t data_size);
+void ipc_lorawan_crypto_random_pool_refill(void);
+int ipc_lorawan_crypto_prepare(const struct ipc_lorawan_crypto_key *keys, uint8_t key_count);
+
+#endif /* APP_IPC_CRYPTO_H */
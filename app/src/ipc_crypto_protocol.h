@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * Messages exchanged between the IPC crypto client and server.
+ */
+
+#ifndef APP_IPC_CRYPTO_PROTOCOL_H
+#define APP_IPC_CRYPTO_PROTOCOL_H
+
+#include <stdint.h>
+#include "ipc_crypto.h"
+
+struct ipc_lorawan_crypto_set_key_data {
+	uint8_t type;
+	uint8_t key_id;
+	uint16_t key_size;
+	uint8_t key[];
+};
+
+struct ipc_lorawan_crypto_set_key_response_data {
+	int rc;
+};
+
+struct ipc_lorawan_crypto_aes128_encrypt_data {
+	uint8_t key_id;
+	uint16_t data_size;
+	uint8_t data[];
+};
+
+struct ipc_lorawan_crypto_aes128_encrypt_response_data {
+	int rc;
+	uint16_t data_size;
+	uint8_t data[];
+};
+
+struct ipc_lorawan_crypto_cmac_aes128_verify_data {
+	uint8_t key_id;
+	uint16_t data_size;
+	uint16_t signature_size;
+	uint8_t data[]; //Data followed by signature
+};
+
+struct ipc_lorawan_crypto_cmac_aes128_verify_response_data {
+	int rc;
+};
+
+struct ipc_lorawan_crypto_prepare_data {
+	uint8_t key_count;
+	struct ipc_lorawan_crypto_key keys[];
+};
+
+struct ipc_lorawan_crypto_random_data {
+	uint16_t data_size;
+};
+
+struct ipc_lorawan_crypto_random_response_data {
+	int rc;
+	uint16_t data_size;
+	uint8_t data[];
+};
+
+#endif /* APP_IPC_CRYPTO_PROTOCOL_H */
@@ -14,7 +14,6 @@
 LOG_MODULE_REGISTER(ipc_endpoint, 4);
 
 #define IPC_MESSAGE_OVERHEAD (data_payload.data - &data_payload.opcode)
-#define IPC_MESSAGE_DATA_SIZE 512
 
 struct ipc_payload {
 	uint8_t opcode;
@@ -30,6 +29,7 @@ static struct ipc_payload data_payload;
 static struct ipc_ept ipc_endpoint;
 static K_SEM_DEFINE(ipc_bound_sem, 0, 1);
 static K_SEM_DEFINE(ipc_receive_sem, 0, 1);
+static K_MUTEX_DEFINE(ipc_send_lock);
 
 static struct ipc_ept_cfg ipc_endpoint_config = {
 	.name = "ep0",
@@ -54,8 +54,7 @@ static void ipc_endpoint_receive(const void *data, size_t len, void *priv)
 	} else if (len != (values->size + IPC_MESSAGE_OVERHEAD)) {
 		printk("len mismatch: %d vs %d", len, (values->size + IPC_MESSAGE_OVERHEAD));
 	} else {
-		printk("got message! %d, %d, %d, %d, %d\n", values->opcode, values->size, values->data[0], values->data[1], values->data[2]);
-LOG_HEXDUMP_ERR(data, len, "DAT");
+		LOG_DBG("Message opcode %d, size %d", values->opcode, values->size);
 	}
 
 	SYS_SLIST_FOR_EACH_NODE_SAFE(&ipc_registered_handlers, snp, sns) {
@@ -100,20 +99,45 @@ int ipc_wait_for_ready()
 
 int ipc_send_message(uint8_t opcode, uint16_t size, const uint8_t *message)
 {
-	int rc;
+	uint8_t *buffer;
 
-	if (size > sizeof(struct ipc_payload)) {
+	if (size > IPC_MESSAGE_DATA_SIZE) {
 		return -1;
 	}
 
+	buffer = ipc_get_buffer();
+//LOG_HEXDUMP_ERR(message, size, "out");
+	memcpy(buffer, message, size);
+
+	return ipc_send_buffer(opcode, size);
+}
+
+uint8_t *ipc_get_buffer(void)
+{
+	/* Messages can be sent from multiple threads, e.g. boot load frames and responses */
+	(void)k_mutex_lock(&ipc_send_lock, K_FOREVER);
+
+	return data_payload.data;
+}
+
+int ipc_send_buffer(uint8_t opcode, uint16_t size)
+{
+	int rc;
+
+	if (size > IPC_MESSAGE_DATA_SIZE) {
+		rc = -1;
+		goto finish;
+	}
+
 	data_payload.opcode = opcode;
 	data_payload.size = size;
-//LOG_HEXDUMP_ERR(message, size, "out");
-	memcpy(data_payload.data, message, size);
 //LOG_HEXDUMP_ERR(&data_payload, (size + IPC_MESSAGE_OVERHEAD), "out2");
 
 	rc = ipc_service_send(&ipc_endpoint, &data_payload, (size + IPC_MESSAGE_OVERHEAD));
 
+finish:
+	k_mutex_unlock(&ipc_send_lock);
+
 	return rc;
 }
 
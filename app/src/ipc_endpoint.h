@@ -10,6 +10,9 @@
 #include <stdint.h>
 #include <zephyr/sys/slist.h>
 
+/* Maximum size of the data in a single IPC message */
+#define IPC_MESSAGE_DATA_SIZE 512
+
 enum ipc_opcode {
 	/* Settings */
 	/* | Client -> server */
@@ -18,9 +21,14 @@ enum ipc_opcode {
 	IPC_OPCODE_SETTINGS_COMMIT,
 	IPC_OPCODE_SETTINGS_TREE_COUNT,
 	IPC_OPCODE_SETTINGS_TREE_LOAD,
+	IPC_OPCODE_SETTINGS_SAVE_BATCH,
+	IPC_OPCODE_SETTINGS_BOOT_SYNC,
+	IPC_OPCODE_SETTINGS_SUBSCRIBE,
 
 	/* | Server -> client */
 	IPC_OPCODE_SETTINGS_BOOT_LOAD,
+	IPC_OPCODE_SETTINGS_INVALIDATE,
+	IPC_OPCODE_SETTINGS_NOTIFY,
 
 	/* Crypto */
 	/* | Client -> server */
@@ -29,6 +37,8 @@ enum ipc_opcode {
 	IPC_OPCODE_CRYPTO_AES128_CCM_ENCRYPT,
 	IPC_OPCODE_CRYPTO_CMAC_AES128_ENCRYPT,
 	IPC_OPCODE_CRYPTO_CMAC_AES128_VERIFY,
+	IPC_OPCODE_CRYPTO_RANDOM,
+	IPC_OPCODE_CRYPTO_PREPARE,
 };
 
 typedef int (*ipc_callback_fn)(const uint8_t *message, uint16_t size, void *user_data);
@@ -54,6 +64,15 @@ int ipc_wait_for_ready();
 /** Send message over IPC */
 int ipc_send_message(uint8_t opcode, uint16_t size, const uint8_t *message);
 
+/**
+ * Get the IPC transmit buffer (of IPC_MESSAGE_DATA_SIZE bytes) so that a message can be built in
+ * place without a copy. Other threads cannot send until ipc_send_buffer() is called.
+ */
+uint8_t *ipc_get_buffer(void);
+
+/** Send the message built in the IPC transmit buffer and release it */
+int ipc_send_buffer(uint8_t opcode, uint16_t size);
+
 /** Register IPC callback handler for an opcode */
 void ipc_register(struct ipc_group *group);
 
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#ifndef APP_IPC_SETTING_IDS_H
+#define APP_IPC_SETTING_IDS_H
+
+#include <stdint.h>
+#include "lorawan_nvm_groups.h"
+
+/*
+ * Settings known to both cores, which are sent over IPC as a 16-bit ID instead of their name.
+ * IDs are the position in this list and both cores must be built with the same list. Settings
+ * which are not listed are sent with their full name. The LoRaWAN NVM names come from the lists
+ * in lorawan_nvm_groups.h which the NVM code saves with: the fixed block of frame counter journal
+ * slots comes first, then each group followed by its delta. A group added at the end of
+ * LORAWAN_NVM_GROUP_LIST therefore adds its IDs at the end and no existing ID changes.
+ */
+#define IPC_SETTING_ID_NVM_FCNT(X, _slot)					\
+	X(LORAWAN_NVM_FCNT_ ## _slot, LORAWAN_SETTINGS_BASE "/" LORAWAN_SETTINGS_FCNT "/" #_slot)
+
+#define IPC_SETTING_ID_NVM_GROUP(X, _id, _member)				\
+	X(LORAWAN_NVM_ ## _id, LORAWAN_SETTINGS_BASE "/" #_member)		\
+	X(LORAWAN_NVM_ ## _id ## _DELTA,					\
+	  LORAWAN_SETTINGS_BASE "/" #_member "/" LORAWAN_SETTINGS_DELTA)
+
+#define IPC_SETTING_ID_LIST(X)							\
+	LORAWAN_NVM_FCNT_SLOT_LIST(IPC_SETTING_ID_NVM_FCNT, X)			\
+	LORAWAN_NVM_GROUP_LIST(IPC_SETTING_ID_NVM_GROUP, X)
+
+#define IPC_SETTING_ID_ENUM(_id, _name) IPC_SETTING_ID_ ## _id,
+
+enum ipc_setting_id {
+	/* Setting without an ID, sent by name */
+	IPC_SETTING_ID_NONE,
+	IPC_SETTING_ID_LIST(IPC_SETTING_ID_ENUM)
+
+	IPC_SETTING_ID_COUNT,
+};
+
+/** Get the name of a setting from its ID, returns NULL if the ID is not known */
+const char *ipc_setting_id_name(uint16_t id);
+
+/** Get the ID of a setting from its name, returns IPC_SETTING_ID_NONE if it does not have one */
+uint16_t ipc_setting_id_find(const char *name);
+
+#endif /* APP_IPC_SETTING_IDS_H */
@@ -10,74 +10,46 @@
 #include <zephyr/init.h>
 #include <zephyr/settings/settings.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
 #include "ipc_endpoint.h"
+#include "ipc_settings.h"
+#include "ipc_setting_ids.h"
+#include "ipc_settings_protocol.h"
 
 #if defined(CONFIG_IPC_SETTINGS_SERVER)
 #include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/random/random.h>
 #endif
 
-LOG_MODULE_REGISTER(ipc_settings, 4);
-
-struct ipc_setting_save_data {
-	uint8_t name_size;
-	uint8_t value_size;
-	uint8_t setting[]; //Name, followed by value
-};
-
-struct ipc_setting_save_response_data {
-	int rc;
-};
-
-struct ipc_setting_load_data {
-	uint8_t name_size;
-	uint8_t max_value_size;
-	uint8_t name[];
-};
-
-struct ipc_setting_load_response_data {
-	int rc;
-	uint8_t value_size;
-	uint8_t setting[];
-};
-
-struct ipc_setting_commit_response_data {
-	int rc;
-};
-
-#if 0
-struct ipc_setting_tree_count_response_data {
-	uint16_t count;
-};
-
-struct ipc_setting_tree_load_data {
-	uint16_t index;
-};
+#if defined(CONFIG_IPC_SETTINGS_IDLE_GC)
+#include <zephyr/fs/zms.h>
+#endif
 
-struct ipc_setting_tree_load_response_data {
-	int rc;
-	uint8_t *name;
-	uint8_t *value;
-	uint8_t *value_size;
-};
+#if defined(CONFIG_IPC_SETTINGS_CACHE) || defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+#include <zephyr/sys/crc.h>
 #endif
 
-struct ipc_setting_boot_load_data {
-	uint8_t name_size;
-	uint8_t value_size;
-	uint8_t setting[]; //Name, followed by value
-};
+LOG_MODULE_REGISTER(ipc_settings, 4);
 
 /* Client -> server */
 static int ipc_setting_callback_save(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_setting_callback_load(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_setting_callback_commit(const uint8_t *message, uint16_t size, void *user_data);
-#if 0
+static int ipc_setting_callback_save_batch(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_setting_callback_tree_count(const uint8_t *message, uint16_t size, void *user_data);
 static int ipc_setting_callback_tree_load(const uint8_t *message, uint16_t size, void *user_data);
+static int ipc_setting_callback_subscribe(const uint8_t *message, uint16_t size, void *user_data);
+#if defined(CONFIG_IPC_SETTINGS_SERVER)
+static int ipc_setting_callback_boot_sync(const uint8_t *message, uint16_t size, void *user_data);
 #endif
 
 /* Server -> client */
 static int ipc_setting_callback_boot_load(const uint8_t *message, uint16_t size, void *user_data);
+#if defined(CONFIG_IPC_SETTINGS_CLIENT)
+static int ipc_setting_callback_invalidate(const uint8_t *message, uint16_t size, void *user_data);
+static int ipc_setting_callback_notify(const uint8_t *message, uint16_t size, void *user_data);
+#endif
 
 #if defined(CONFIG_IPC_SETTINGS_CLIENT)
 static struct {
@@ -85,9 +57,97 @@ static struct {
 	struct k_sem done;
 	int rc;
 	uint8_t *load_pointer;
-	uint8_t load_size;
+	uint16_t load_size;
 } ipc_settings_data;
 
+/* Last tree load page received from the server, parsed by the thread which requested it */
+static struct {
+	struct k_mutex lock;
+	uint16_t count;
+	uint16_t size;
+	uint8_t buffer[IPC_MESSAGE_DATA_SIZE];
+} ipc_settings_tree;
+
+/* Boot load progress, used to report how long it took for settings to be available. A value sent
+ * in several records is joined in value before it is loaded
+ */
+static struct {
+	struct k_sem done;
+	uint16_t records;
+	uint16_t frames;
+	int64_t first_frame_ticks;
+	bool partial;
+	bool retained_full;
+	uint16_t value_size;
+	uint8_t name[SETTINGS_MAX_NAME_LEN + 1];
+	uint8_t value[CONFIG_IPC_SETTINGS_MAX_VALUE_SIZE];
+} ipc_settings_boot_sync;
+
+#define IPC_SETTING_BOOT_SYNC_TIMEOUT K_SECONDS(30)
+
+/* Subscriptions which change notifications from the server are passed to */
+static struct {
+	struct k_mutex lock;
+	sys_slist_t list;
+} ipc_settings_subscriptions;
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+/* Settings received in boot loads, in RAM which is not cleared when the client restarts, so that
+ * after a restart the server only needs to send settings which changed since generation. Records
+ * are in ipc_setting_save_data format, the crc covers everything after it
+ */
+#define IPC_SETTING_RETAINED_MAGIC 0x49505352
+
+static __noinit struct {
+	uint32_t magic;
+	uint32_t crc;
+	uint32_t epoch;
+	uint32_t generation;
+	uint16_t used;
+	uint8_t buffer[CONFIG_IPC_SETTINGS_WARM_SYNC_SIZE];
+} ipc_settings_retained;
+#endif
+
+struct ipc_setting_value {
+	const uint8_t *value;
+	uint16_t value_size;
+};
+
+/* Save session, records are collected here and sent to the server one frame at a time */
+static struct {
+	struct k_mutex lock;
+	uint8_t depth;
+	bool commit;
+	bool staged;
+	int rc;
+	bool aborted;
+	uint16_t used;
+	uint8_t buffer[IPC_MESSAGE_DATA_SIZE];
+} ipc_settings_batch;
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+/* Copies of recently used settings, the name and value of each entry are kept back to back in the
+ * arena
+ */
+struct ipc_setting_cache_entry {
+	uint32_t name_hash;
+	uint32_t last_used;
+	uint16_t offset;
+	uint16_t value_size;
+	uint8_t name_size;
+	bool used;
+};
+
+static struct {
+	struct k_mutex lock;
+	struct ipc_setting_cache_entry entries[CONFIG_IPC_SETTINGS_CACHE_ENTRIES];
+	struct ipc_setting_cache_stats stats;
+	uint32_t counter;
+	uint16_t used;
+	uint8_t arena[CONFIG_IPC_SETTINGS_CACHE_SIZE];
+} ipc_settings_cache;
+#endif
+
 static struct ipc_group ipc_group_save = {
 	.callback = ipc_setting_callback_save,
 	.opcode = IPC_OPCODE_SETTINGS_SAVE,
@@ -106,7 +166,12 @@ static struct ipc_group ipc_group_commit = {
 	.user_data = &ipc_settings_data,
 };
 
-#if 0
+static struct ipc_group ipc_group_save_batch = {
+	.callback = ipc_setting_callback_save_batch,
+	.opcode = IPC_OPCODE_SETTINGS_SAVE_BATCH,
+	.user_data = &ipc_settings_data,
+};
+
 static struct ipc_group ipc_group_tree_count = {
 	.callback = ipc_setting_callback_tree_count,
 	.opcode = IPC_OPCODE_SETTINGS_TREE_COUNT,
@@ -118,14 +183,121 @@ static struct ipc_group ipc_group_tree_load = {
 	.opcode = IPC_OPCODE_SETTINGS_TREE_LOAD,
 	.user_data = &ipc_settings_data,
 };
-#endif
+
+static struct ipc_group ipc_group_subscribe = {
+	.callback = ipc_setting_callback_subscribe,
+	.opcode = IPC_OPCODE_SETTINGS_SUBSCRIBE,
+	.user_data = &ipc_settings_data,
+};
 
 static struct ipc_group ipc_group_boot_load = {
 	.callback = ipc_setting_callback_boot_load,
 	.opcode = IPC_OPCODE_SETTINGS_BOOT_LOAD,
 };
+
+static struct ipc_group ipc_group_invalidate = {
+	.callback = ipc_setting_callback_invalidate,
+	.opcode = IPC_OPCODE_SETTINGS_INVALIDATE,
+};
+
+static struct ipc_group ipc_group_notify = {
+	.callback = ipc_setting_callback_notify,
+	.opcode = IPC_OPCODE_SETTINGS_NOTIFY,
+};
 #endif
 
+#define IPC_SETTING_ID_NAME(_id, _name) [IPC_SETTING_ID_ ## _id] = _name,
+
+static const char * const ipc_setting_id_names[IPC_SETTING_ID_COUNT] = {
+	IPC_SETTING_ID_LIST(IPC_SETTING_ID_NAME)
+};
+
+const char *ipc_setting_id_name(uint16_t id)
+{
+	return (id < ARRAY_SIZE(ipc_setting_id_names) ? ipc_setting_id_names[id] : NULL);
+}
+
+BUILD_ASSERT(IPC_SETTING_ID_COUNT <= (UINT8_MAX + 1), "Setting IDs do not fit the sorted table");
+
+/* IDs ordered by the name of their setting so that a name is found with a binary search, sorted
+ * when the module is registered
+ */
+static uint8_t ipc_setting_id_order[(IPC_SETTING_ID_COUNT - 1)];
+
+static int ipc_setting_id_compare(const void *a, const void *b)
+{
+	return strcmp(ipc_setting_id_names[*(const uint8_t *)a],
+		      ipc_setting_id_names[*(const uint8_t *)b]);
+}
+
+static void ipc_setting_id_sort(void)
+{
+	uint16_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_setting_id_order); ++i) {
+		ipc_setting_id_order[i] = (IPC_SETTING_ID_NONE + 1) + i;
+	}
+
+	qsort(ipc_setting_id_order, ARRAY_SIZE(ipc_setting_id_order), sizeof(ipc_setting_id_order[0]),
+	      ipc_setting_id_compare);
+}
+
+uint16_t ipc_setting_id_find(const char *name)
+{
+	uint16_t low = 0;
+	uint16_t high = ARRAY_SIZE(ipc_setting_id_order);
+
+	while (low < high) {
+		uint16_t middle = low + ((high - low) / 2);
+		int rc = strcmp(name, ipc_setting_id_names[ipc_setting_id_order[middle]]);
+
+		if (rc == 0) {
+			return ipc_setting_id_order[middle];
+		} else if (rc < 0) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+
+	return IPC_SETTING_ID_NONE;
+}
+
+/* Size of the name field of a record for a setting, id is set if it is sent as an ID */
+static uint8_t ipc_setting_record_name_size(const char *name, uint16_t *id)
+{
+	*id = ipc_setting_id_find(name);
+
+	return (*id != IPC_SETTING_ID_NONE ? sizeof(uint16_t) : (strlen(name) + 1));
+}
+
+/* Writes the name field of a record, returns the flags to add to the record */
+static uint8_t ipc_setting_record_name_put(uint8_t *field, const char *name, uint16_t id, uint8_t name_size)
+{
+	if (id != IPC_SETTING_ID_NONE) {
+		sys_put_le16(id, field);
+		return IPC_SETTING_RECORD_FLAG_ID;
+	}
+
+	memcpy(field, name, name_size);
+
+	return 0;
+}
+
+/* Name of the setting of a record, NULL if the name field is not valid */
+static const char *ipc_setting_record_name(const uint8_t *field, uint8_t name_size, uint8_t flags)
+{
+	if (flags & IPC_SETTING_RECORD_FLAG_ID) {
+		return (name_size == sizeof(uint16_t) ? ipc_setting_id_name(sys_get_le16(field)) : NULL);
+	}
+
+	if (name_size == 0 || field[(name_size - 1)] != '\0') {
+		return NULL;
+	}
+
+	return (const char *)field;
+}
+
 #if defined(CONFIG_IPC_SETTINGS_SERVER)
 static struct {
 	struct k_sem busy;
@@ -133,6 +305,231 @@ static struct {
 	int rc;
 } ipc_settings_data;
 
+/* Records received in a save session, written when the last frame of the session arrives. A
+ * value sent in several records is joined into the last staged record
+ */
+static struct {
+	int rc;
+	uint16_t used;
+	uint16_t last;
+	bool partial;
+	uint8_t buffer[CONFIG_IPC_SETTINGS_BATCH_STAGING_SIZE];
+} ipc_settings_staging;
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+/* Changed records of a session which writes more than one key are saved here, with the full name
+ * of each key, before they are written and deleted once all of them have been. A journal found at
+ * startup, or kept because a write failed, belongs to a session which was cut off, its keys are
+ * written again so that none of them are left with old values
+ */
+#define IPC_SETTING_JOURNAL_KEY "ipc/journal"
+
+/* Set if the journal is kept because its keys could not all be written */
+static bool ipc_settings_journal_pending;
+#endif
+
+/* Hash of the value last written to (or read from) storage for recently used keys, a key is only
+ * written if it changed since then
+ */
+struct ipc_setting_key_state {
+	uint32_t name_hash;
+	uint32_t value_hash;
+	uint32_t last_used;
+	uint16_t value_size;
+	bool used;
+};
+
+/* Boot load frame being filled, up to CONFIG_IPC_SETTINGS_BOOT_LOAD_WINDOW frames can be sent
+ * without having been acknowledged by the client
+ */
+#define IPC_SETTING_BOOT_LOAD_ACK_TIMEOUT K_SECONDS(5)
+
+static struct {
+	struct k_sem credits;
+	uint8_t seq;
+	uint8_t ack_seq;
+	uint8_t flags;
+	/* Settings which did not change after since are not sent, 0 to send all */
+	uint32_t since;
+	uint32_t generation;
+	uint16_t used;
+	uint16_t records;
+	uint16_t frames;
+	uint32_t bytes;
+	uint8_t buffer[CONFIG_IPC_SETTINGS_BOOT_LOAD_FRAME_SIZE];
+} ipc_settings_boot_load;
+
+/* Tree load page being filled, settings before the cursor are skipped */
+static struct {
+	const uint8_t *prefix;
+	uint16_t index;
+	uint16_t cursor;
+	uint16_t count;
+	uint16_t used;
+	bool full;
+	uint8_t buffer[IPC_MESSAGE_DATA_SIZE];
+} ipc_settings_tree;
+
+/* Value of a load request, read before the IPC transmit buffer is taken so that other messages
+ * can be sent while storage is read
+ */
+static uint8_t ipc_settings_load_value[IPC_SETTING_LOAD_MAX_VALUE_SIZE];
+
+static struct ipc_setting_key_state key_states[CONFIG_IPC_SETTINGS_KEY_STATES];
+static uint32_t key_state_counter;
+static K_MUTEX_DEFINE(key_state_lock);
+
+/* Protected by key_state_lock */
+static struct ipc_setting_save_stats ipc_settings_save_stats;
+
+/* Storage backend registered by settings_subsys_init(), from Zephyr's settings_priv.h */
+extern struct settings_store *settings_save_dst;
+
+static int ipc_setting_store_save_start(struct settings_store *cs);
+static int ipc_setting_store_save(struct settings_store *cs, const char *name, const char *value,
+				  size_t val_len);
+static int ipc_setting_store_save_end(struct settings_store *cs);
+static void *ipc_setting_store_storage_get(struct settings_store *cs);
+static void ipc_setting_changed_work_handler(struct k_work *work);
+
+static const struct settings_store_itf ipc_setting_store_interface = {
+	.csi_save_start = ipc_setting_store_save_start,
+	.csi_save = ipc_setting_store_save,
+	.csi_save_end = ipc_setting_store_save_end,
+	.csi_storage_get = ipc_setting_store_storage_get,
+};
+
+/* Write hook placed in front of the storage backend, so that the key states, index and generations
+ * follow every write and the client (its cache and subscriptions) is told about writes made with
+ * settings_save_one() or settings_delete() on the application core. The changed keys are
+ * protected by key_state_lock and sent from the system workqueue, client_writer is the thread
+ * writing a key for the client (holding client_write_lock)
+ */
+static struct {
+	struct settings_store store;
+	struct settings_store *backend;
+	k_tid_t client_writer;
+	bool overflow;
+	uint8_t changed_count;
+	uint8_t changed[CONFIG_IPC_SETTINGS_NOTIFY_PENDING][(SETTINGS_MAX_NAME_LEN + 1)];
+	uint8_t name[(SETTINGS_MAX_NAME_LEN + 1)];
+} ipc_settings_writes = {
+	.store = {
+		.cs_itf = &ipc_setting_store_interface,
+	},
+};
+
+/* Keeps the unchanged check and the write of a key saved by the client together */
+static K_MUTEX_DEFINE(client_write_lock);
+static K_WORK_DEFINE(ipc_settings_changed_work, ipc_setting_changed_work_handler);
+
+#if defined(CONFIG_IPC_SETTINGS_IDLE_GC)
+/* Runs once no settings request has been received for CONFIG_IPC_SETTINGS_IDLE_GC_DELAY, so that
+ * storage garbage collection is done then instead of in a save which the client waits for
+ */
+static void ipc_setting_gc_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(ipc_settings_gc_work, ipc_setting_gc_work_handler);
+#endif
+
+/* Generation (a counter incremented by every write) of the last change of recently written keys,
+ * protected by key_state_lock. Keys which are not listed have not changed since floor, which is
+ * raised when a change or a deletion is forgotten. Recently deleted keys are kept by name, so
+ * that a client can be told about them in a boot load of changes. Epoch is random and changes
+ * each time the server starts, generations of another epoch are not comparable
+ */
+struct ipc_setting_generation {
+	uint32_t name_hash;
+	uint32_t generation;
+};
+
+struct ipc_setting_tombstone {
+	uint32_t generation;
+	char name[(SETTINGS_MAX_NAME_LEN + 1)];
+};
+
+static struct {
+	uint32_t epoch;
+	uint32_t generation;
+	uint32_t floor;
+	struct ipc_setting_generation keys[CONFIG_IPC_SETTINGS_GENERATION_KEYS];
+	struct ipc_setting_tombstone tombstones[CONFIG_IPC_SETTINGS_TOMBSTONES];
+} ipc_settings_generation;
+
+/* Boot sync request from the client, served once the server is ready */
+static struct {
+	bool ready;
+	bool pending;
+	uint32_t epoch;
+	uint32_t generation;
+	uint8_t key[(SETTINGS_MAX_NAME_LEN + 1)];
+} ipc_settings_boot_sync_request;
+
+static void ipc_setting_boot_sync_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(ipc_settings_boot_sync_work, ipc_setting_boot_sync_work_handler);
+
+/* Boot loads wait up to IPC_SETTING_BOOT_LOAD_ACK_TIMEOUT for each frame to be acknowledged, so
+ * have their own work queue rather than holding up the system work queue
+ */
+static struct k_work_q ipc_settings_boot_sync_work_q;
+static K_THREAD_STACK_DEFINE(ipc_settings_boot_sync_stack, CONFIG_IPC_SETTINGS_BOOT_SYNC_STACK_SIZE);
+static const struct k_work_queue_config ipc_settings_boot_sync_work_q_config = {
+	.name = "ipc_boot_sync",
+};
+
+/* Prefixes the client subscribed to (count is the number of subscriptions, 0 if unused) and
+ * subscribed settings which changed since the last notification. Values are read when the
+ * notification is sent, so a setting changed several times is only sent once
+ */
+struct ipc_setting_subscribed_prefix {
+	uint8_t count;
+	uint8_t prefix[(SETTINGS_MAX_NAME_LEN + 1)];
+};
+
+static struct {
+	struct k_mutex lock;
+	struct ipc_setting_subscribed_prefix prefixes[CONFIG_IPC_SETTINGS_SUBSCRIPTIONS];
+	uint8_t pending_count;
+	uint8_t pending[CONFIG_IPC_SETTINGS_NOTIFY_PENDING][(SETTINGS_MAX_NAME_LEN + 1)];
+	uint16_t used;
+	uint8_t value[IPC_MESSAGE_DATA_SIZE];
+	uint8_t buffer[IPC_MESSAGE_DATA_SIZE];
+} ipc_settings_notify;
+
+static void ipc_setting_notify_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(ipc_settings_notify_work, ipc_setting_notify_work_handler);
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+/* Recently used stored settings (not an index of storage offsets, misses read the subtree from
+ * storage), a hash table (with linear probing) of entries whose name and value are
+ * kept back to back in the arena. Exists is false for keys known not to be in storage
+ */
+struct ipc_setting_index_entry {
+	uint32_t name_hash;
+	uint32_t last_used;
+	uint16_t offset;
+	uint16_t value_size;
+	uint8_t name_size;
+	bool used;
+	bool exists;
+};
+
+/* Entries are evicted before the table is more than 3/4 full to keep probe sequences short */
+#define IPC_SETTING_INDEX_MAX_ENTRIES ((CONFIG_IPC_SETTINGS_INDEX_ENTRIES * 3) / 4)
+
+static struct {
+	struct k_mutex lock;
+	struct ipc_setting_index_entry entries[CONFIG_IPC_SETTINGS_INDEX_ENTRIES];
+	struct ipc_setting_index_stats stats;
+	uint32_t counter;
+	uint16_t count;
+	uint16_t used;
+	uint8_t arena[CONFIG_IPC_SETTINGS_INDEX_SIZE];
+} ipc_settings_index;
+#endif
+
 static struct ipc_group ipc_group_save = {
 	.callback = ipc_setting_callback_save,
 	.opcode = IPC_OPCODE_SETTINGS_SAVE,
@@ -148,7 +545,11 @@ static struct ipc_group ipc_group_commit = {
 	.opcode = IPC_OPCODE_SETTINGS_COMMIT,
 };
 
-#if 0
+static struct ipc_group ipc_group_save_batch = {
+	.callback = ipc_setting_callback_save_batch,
+	.opcode = IPC_OPCODE_SETTINGS_SAVE_BATCH,
+};
+
 static struct ipc_group ipc_group_tree_count = {
 	.callback = ipc_setting_callback_tree_count,
 	.opcode = IPC_OPCODE_SETTINGS_TREE_COUNT,
@@ -158,280 +559,2741 @@ static struct ipc_group ipc_group_tree_load = {
 	.callback = ipc_setting_callback_tree_load,
 	.opcode = IPC_OPCODE_SETTINGS_TREE_LOAD,
 };
-#endif
 
 static struct ipc_group ipc_group_boot_load = {
 	.callback = ipc_setting_callback_boot_load,
 	.opcode = IPC_OPCODE_SETTINGS_BOOT_LOAD,
 	.user_data = &ipc_settings_data,
 };
+
+static struct ipc_group ipc_group_boot_sync = {
+	.callback = ipc_setting_callback_boot_sync,
+	.opcode = IPC_OPCODE_SETTINGS_BOOT_SYNC,
+};
+
+static struct ipc_group ipc_group_subscribe = {
+	.callback = ipc_setting_callback_subscribe,
+	.opcode = IPC_OPCODE_SETTINGS_SUBSCRIBE,
+};
 #endif
 
 #if defined(CONFIG_IPC_SETTINGS_SERVER)
-static int ipc_setting_callback_save(const uint8_t *message, uint16_t size, void *user_data)
+static struct ipc_setting_key_state *key_state_get(const char *name)
 {
-	int rc;
-	struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)message;
-	struct ipc_setting_save_response_data data;
+	uint32_t name_hash = crc32_ieee((const uint8_t *)name, strlen(name));
+	struct ipc_setting_key_state *replace = NULL;
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(key_states); ++i) {
+		struct ipc_setting_key_state *state = &key_states[i];
 
-	rc = settings_save_one(setting->setting, &setting->setting[setting->name_size], setting->value_size);
+		if (state->used && state->name_hash == name_hash) {
+			state->last_used = ++key_state_counter;
+			return state;
+		}
 
-LOG_ERR("abc: %d for %s", rc, setting->setting);
-data.rc = rc;
+		if (replace == NULL || (replace->used && (!state->used ||
+						       state->last_used < replace->last_used))) {
+			replace = state;
+		}
+	}
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SAVE, sizeof(data), (uint8_t *)&data);
+	/* Least recently used key is forgotten, it will be written the next time it is saved */
+	replace->name_hash = name_hash;
+	replace->used = false;
+	replace->last_used = ++key_state_counter;
 
-	return rc;
+	return replace;
 }
 
-static int ipc_setting_callback_load(const uint8_t *message, uint16_t size, void *user_data)
+static bool key_state_matches(const struct ipc_setting_key_state *state, const uint8_t *value, uint16_t value_size)
 {
-	int rc;
-	struct ipc_setting_load_data *setting = (struct ipc_setting_load_data *)message;
-	struct ipc_setting_load_response_data *data;
+	return (state->used && state->value_size == value_size &&
+		state->value_hash == crc32_ieee(value, value_size));
+}
 
-	data = (struct ipc_setting_load_response_data *)malloc(16);
+static void key_state_set(struct ipc_setting_key_state *state, const uint8_t *value, uint16_t value_size)
+{
+	state->value_hash = crc32_ieee(value, value_size);
+	state->value_size = value_size;
+	state->used = true;
+}
 
-	rc = settings_runtime_get(setting->name, data->setting, setting->max_value_size);
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+static struct ipc_setting_index_entry *index_find(const char *name, uint8_t name_size, uint32_t name_hash)
+{
+	uint16_t slot = name_hash % ARRAY_SIZE(ipc_settings_index.entries);
 
-LOG_ERR("def: %d for %s", rc, setting->name);
-data->rc = rc;
+	while (ipc_settings_index.entries[slot].used) {
+		struct ipc_setting_index_entry *entry = &ipc_settings_index.entries[slot];
 
-	data->value_size = (rc >= 0 ? rc : 0);
+		if (entry->name_hash == name_hash && entry->name_size == name_size &&
+		    memcmp(&ipc_settings_index.arena[entry->offset], name, name_size) == 0) {
+			return entry;
+		}
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_LOAD, 16, (uint8_t *)data);
-	free(data);
+		slot = (slot + 1) % ARRAY_SIZE(ipc_settings_index.entries);
+	}
+
+	return NULL;
+}
+
+static void index_remove(struct ipc_setting_index_entry *entry)
+{
+	uint16_t entry_size = entry->name_size + entry->value_size;
+	uint16_t end = entry->offset + entry_size;
+	uint16_t slot = entry - ipc_settings_index.entries;
+	uint16_t next = slot;
+	uint16_t i;
+
+	memmove(&ipc_settings_index.arena[entry->offset], &ipc_settings_index.arena[end],
+		(ipc_settings_index.used - end));
+	ipc_settings_index.used -= entry_size;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_index.entries); ++i) {
+		struct ipc_setting_index_entry *other = &ipc_settings_index.entries[i];
+
+		if (other->used && other->offset > entry->offset) {
+			other->offset -= entry_size;
+		}
+	}
+
+	/* Move later entries of the probe sequence back so that there is no gap in it */
+	while (1) {
+		uint16_t home;
+
+		next = (next + 1) % ARRAY_SIZE(ipc_settings_index.entries);
+
+		if (!ipc_settings_index.entries[next].used) {
+			break;
+		}
+
+		home = ipc_settings_index.entries[next].name_hash % ARRAY_SIZE(ipc_settings_index.entries);
+
+		if ((slot <= next) ? (home <= slot || home > next) : (home <= slot && home > next)) {
+			ipc_settings_index.entries[slot] = ipc_settings_index.entries[next];
+			slot = next;
+		}
+	}
+
+	ipc_settings_index.entries[slot].used = false;
+	--ipc_settings_index.count;
+}
+
+/* Adds or updates the index entry of a key, keys which were deleted are stored with exists false */
+static void index_store(const char *name, const uint8_t *value, uint16_t value_size, bool exists)
+{
+	struct ipc_setting_index_entry *entry;
+	uint8_t name_size = strlen(name) + 1;
+	uint32_t name_hash = crc32_ieee((const uint8_t *)name, name_size);
+	uint32_t entry_size = name_size + value_size;
+	uint16_t slot;
+	uint16_t i;
+
+	(void)k_mutex_lock(&ipc_settings_index.lock, K_FOREVER);
+	entry = index_find(name, name_size, name_hash);
+
+	if (entry != NULL) {
+		index_remove(entry);
+	}
+
+	if (entry_size > sizeof(ipc_settings_index.arena)) {
+		goto finish;
+	}
+
+	/* Remove least recently used entries until there is a free entry and enough space */
+	while (ipc_settings_index.count >= IPC_SETTING_INDEX_MAX_ENTRIES ||
+	       (ipc_settings_index.used + entry_size) > sizeof(ipc_settings_index.arena)) {
+		struct ipc_setting_index_entry *oldest = NULL;
+
+		for (i = 0; i < ARRAY_SIZE(ipc_settings_index.entries); ++i) {
+			struct ipc_setting_index_entry *check = &ipc_settings_index.entries[i];
+
+			if (check->used && (oldest == NULL || check->last_used < oldest->last_used)) {
+				oldest = check;
+			}
+		}
+
+		index_remove(oldest);
+		++ipc_settings_index.stats.evictions;
+	}
+
+	slot = name_hash % ARRAY_SIZE(ipc_settings_index.entries);
+
+	while (ipc_settings_index.entries[slot].used) {
+		slot = (slot + 1) % ARRAY_SIZE(ipc_settings_index.entries);
+	}
+
+	entry = &ipc_settings_index.entries[slot];
+	entry->name_hash = name_hash;
+	entry->last_used = ++ipc_settings_index.counter;
+	entry->offset = ipc_settings_index.used;
+	entry->name_size = name_size;
+	entry->value_size = value_size;
+	entry->exists = exists;
+	entry->used = true;
+	memcpy(&ipc_settings_index.arena[entry->offset], name, name_size);
+	memcpy(&ipc_settings_index.arena[(entry->offset + name_size)], value, value_size);
+	ipc_settings_index.used += entry_size;
+	++ipc_settings_index.count;
+
+finish:
+	k_mutex_unlock(&ipc_settings_index.lock);
+}
+
+/* Returns the size of the value, -E2BIG if it is larger than max_value_size, -ENOENT if the key is
+ * not in storage or -ESRCH if it is not indexed
+ */
+static int index_load(const char *name, uint8_t *value, uint16_t max_value_size)
+{
+	int rc = -ESRCH;
+	struct ipc_setting_index_entry *entry;
+	uint8_t name_size = strlen(name) + 1;
+
+	(void)k_mutex_lock(&ipc_settings_index.lock, K_FOREVER);
+	entry = index_find(name, name_size, crc32_ieee((const uint8_t *)name, name_size));
+
+	if (entry == NULL) {
+		++ipc_settings_index.stats.misses;
+		goto finish;
+	}
+
+	if (!entry->exists) {
+		rc = -ENOENT;
+	} else if (entry->value_size > max_value_size) {
+		rc = -E2BIG;
+	} else {
+		rc = entry->value_size;
+		memcpy(value, &ipc_settings_index.arena[(entry->offset + entry->name_size)], rc);
+	}
+
+	entry->last_used = ++ipc_settings_index.counter;
+	++ipc_settings_index.stats.hits;
+
+finish:
+	k_mutex_unlock(&ipc_settings_index.lock);
 
 	return rc;
 }
 
-static int ipc_setting_callback_commit(const uint8_t *message, uint16_t size, void *user_data)
+int ipc_setting_index_stats_get(struct ipc_setting_index_stats *stats)
 {
-	int rc;
-	struct ipc_setting_commit_response_data data;
+	(void)k_mutex_lock(&ipc_settings_index.lock, K_FOREVER);
+	*stats = ipc_settings_index.stats;
+	stats->entries = ipc_settings_index.count;
+	stats->used = ipc_settings_index.used;
+	stats->ram_size = sizeof(ipc_settings_index);
+	k_mutex_unlock(&ipc_settings_index.lock);
+
+	return 0;
+}
+#endif
 
-	rc = settings_save();
-data.rc = rc;
+/* Records or removes the deletion of a key, key_state_lock must be held */
+static void tombstone_set(const char *name, bool deleted)
+{
+	struct ipc_setting_tombstone *replace = &ipc_settings_generation.tombstones[0];
+	uint8_t i;
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_COMMIT, sizeof(data), (uint8_t *)&data);
+	if ((strlen(name) + 1) > sizeof(replace->name)) {
+		if (deleted) {
+			/* Deletion cannot be sent, the client needs a full boot load */
+			ipc_settings_generation.floor = ipc_settings_generation.generation;
+		}
+
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_generation.tombstones); ++i) {
+		struct ipc_setting_tombstone *tombstone = &ipc_settings_generation.tombstones[i];
+
+		if (tombstone->generation != 0 && strcmp(tombstone->name, name) == 0) {
+			replace = tombstone;
+			break;
+		}
+
+		if (tombstone->generation < replace->generation) {
+			replace = tombstone;
+		}
+	}
+
+	if (!deleted) {
+		if (replace->generation != 0 && strcmp(replace->name, name) == 0) {
+			/* Key exists again, it is sent with its value */
+			replace->generation = 0;
+		}
+
+		return;
+	}
+
+	if (replace->generation > ipc_settings_generation.floor && strcmp(replace->name, name) != 0) {
+		/* Oldest deletion is forgotten, clients which have not seen it need a full boot load */
+		ipc_settings_generation.floor = replace->generation;
+	}
+
+	strcpy(replace->name, name);
+	replace->generation = ipc_settings_generation.generation;
+}
+
+/* Records a change of a key, key_state_lock must be held */
+static void generation_set(const char *name, uint32_t name_hash, bool deleted)
+{
+	struct ipc_setting_generation *replace = &ipc_settings_generation.keys[0];
+	uint8_t i;
+
+	++ipc_settings_generation.generation;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_generation.keys); ++i) {
+		struct ipc_setting_generation *key = &ipc_settings_generation.keys[i];
+
+		if (key->generation != 0 && key->name_hash == name_hash) {
+			replace = key;
+			break;
+		}
+
+		if (key->generation < replace->generation) {
+			replace = key;
+		}
+	}
+
+	if (replace->name_hash != name_hash && replace->generation > ipc_settings_generation.floor) {
+		/* Oldest change is forgotten, clients which have not seen it need a full boot load */
+		ipc_settings_generation.floor = replace->generation;
+	}
+
+	replace->name_hash = name_hash;
+	replace->generation = ipc_settings_generation.generation;
+
+	tombstone_set(name, deleted);
+}
+
+/* Returns the generation of the last change of a key, key_state_lock must be held */
+static uint32_t generation_get(uint32_t name_hash)
+{
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_generation.keys); ++i) {
+		if (ipc_settings_generation.keys[i].generation != 0 &&
+		    ipc_settings_generation.keys[i].name_hash == name_hash) {
+			return ipc_settings_generation.keys[i].generation;
+		}
+	}
+
+	return ipc_settings_generation.floor;
+}
+
+/* Called for each settings request, idle garbage collection waits until requests have stopped */
+static void ipc_setting_idle_defer(void)
+{
+#if defined(CONFIG_IPC_SETTINGS_IDLE_GC)
+	(void)k_work_reschedule(&ipc_settings_gc_work, K_MSEC(CONFIG_IPC_SETTINGS_IDLE_GC_DELAY));
+#endif
+}
+
+/* Adds a save to the latency histogram, key_state_lock must be held */
+static void save_latency_add(uint32_t us)
+{
+	uint8_t bucket = 0;
+
+	while (bucket < (IPC_SETTING_SAVE_LATENCY_BUCKETS - 1) && us >= (64U << bucket)) {
+		++bucket;
+	}
+
+	++ipc_settings_save_stats.latency[bucket];
+
+	if (us > ipc_settings_save_stats.max_us) {
+		ipc_settings_save_stats.max_us = us;
+	}
+}
+
+int ipc_setting_save_stats_get(struct ipc_setting_save_stats *stats)
+{
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	*stats = ipc_settings_save_stats;
+	k_mutex_unlock(&key_state_lock);
+
+	return 0;
+}
+
+#if defined(CONFIG_IPC_SETTINGS_IDLE_GC)
+static void ipc_setting_gc_work_handler(struct k_work *work)
+{
+	int rc;
+	void *storage;
+	ssize_t free_space;
+	int64_t start;
+	uint32_t gc_us;
+
+	rc = settings_storage_get(&storage);
+
+	if (rc != 0) {
+		LOG_ERR("Settings storage not available for garbage collection: %d", rc);
+		return;
+	}
+
+	/* ZMS keeps writes out of the sector change itself, key_state_lock is only taken to update the
+	 * statistics so that saves are not held up by the garbage collection
+	 */
+	free_space = zms_active_sector_free_space((struct zms_fs *)storage);
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	ipc_settings_save_stats.free_space = free_space;
+	k_mutex_unlock(&key_state_lock);
+
+	if (free_space < 0 || free_space >= CONFIG_IPC_SETTINGS_IDLE_GC_THRESHOLD) {
+		return;
+	}
+
+	/* Moving to the next sector garbage collects the sector after it now, rather than when a
+	 * later save fills the active sector
+	 */
+	start = k_uptime_ticks();
+	rc = zms_sector_use_next((struct zms_fs *)storage);
+	gc_us = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+	if (rc == 0) {
+		ssize_t gc_free_space = zms_active_sector_free_space((struct zms_fs *)storage);
+
+		(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+		++ipc_settings_save_stats.gc_runs;
+		ipc_settings_save_stats.gc_max_us = MAX(ipc_settings_save_stats.gc_max_us, gc_us);
+		ipc_settings_save_stats.free_space = gc_free_space;
+		k_mutex_unlock(&key_state_lock);
+	}
+
+	LOG_DBG("Idle garbage collection with %d bytes free took %u us, rc: %d", (int)free_space, gc_us, rc);
+}
+#endif
+
+/* Adds a key written on the application core to the changes sent to the client, key_state_lock must
+ * be held
+ */
+static void ipc_setting_changed_add(const char *name)
+{
+	uint8_t i;
+
+	if ((strlen(name) + 1) > sizeof(ipc_settings_writes.changed[0])) {
+		ipc_settings_writes.overflow = true;
+		goto finish;
+	}
+
+	for (i = 0; i < ipc_settings_writes.changed_count; ++i) {
+		if (strcmp(ipc_settings_writes.changed[i], name) == 0) {
+			goto finish;
+		}
+	}
+
+	if (ipc_settings_writes.changed_count == ARRAY_SIZE(ipc_settings_writes.changed)) {
+		/* Whole cache of the client is dropped instead */
+		ipc_settings_writes.overflow = true;
+		goto finish;
+	}
+
+	strcpy(ipc_settings_writes.changed[ipc_settings_writes.changed_count], name);
+	++ipc_settings_writes.changed_count;
+
+finish:
+	(void)k_work_submit(&ipc_settings_changed_work);
+}
+
+/* Every write to storage on the application core passes through here once the server is ready */
+static int ipc_setting_store_save(struct settings_store *cs, const char *name, const char *value,
+				  size_t val_len)
+{
+	int rc;
+	struct settings_store *backend = ipc_settings_writes.backend;
+	struct ipc_setting_key_state *state;
+
+	rc = backend->cs_itf->csi_save(backend, name, value, val_len);
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+	if (strcmp(name, IPC_SETTING_JOURNAL_KEY) == 0) {
+		return rc;
+	}
+#endif
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	state = key_state_get(name);
+
+	if (rc == 0) {
+		key_state_set(state, (const uint8_t *)value, val_len);
+		generation_set(name, state->name_hash, (val_len == 0));
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+		/* A zero length value deletes the key */
+		index_store(name, (const uint8_t *)value, val_len, (val_len > 0));
+#endif
+
+		if (k_current_get() != ipc_settings_writes.client_writer) {
+			/* Client only needs to hear about changes it did not make itself */
+			ipc_setting_changed_add(name);
+		}
+	} else {
+		state->used = false;
+	}
+
+	k_mutex_unlock(&key_state_lock);
+
+	return rc;
+}
+
+static int ipc_setting_store_save_start(struct settings_store *cs)
+{
+	struct settings_store *backend = ipc_settings_writes.backend;
+
+	return (backend->cs_itf->csi_save_start != NULL ? backend->cs_itf->csi_save_start(backend) : 0);
+}
+
+static int ipc_setting_store_save_end(struct settings_store *cs)
+{
+	struct settings_store *backend = ipc_settings_writes.backend;
+
+	return (backend->cs_itf->csi_save_end != NULL ? backend->cs_itf->csi_save_end(backend) : 0);
+}
+
+static void *ipc_setting_store_storage_get(struct settings_store *cs)
+{
+	struct settings_store *backend = ipc_settings_writes.backend;
+
+	return (backend->cs_itf->csi_storage_get != NULL ? backend->cs_itf->csi_storage_get(backend) : NULL);
+}
+
+/* Places the write hook in front of the storage backend set up by settings_subsys_init() */
+static void ipc_setting_store_install(void)
+{
+	if (settings_save_dst == NULL) {
+		LOG_ERR("No settings storage, writes on the application core are not tracked");
+		return;
+	}
+
+	if (settings_save_dst != &ipc_settings_writes.store) {
+		ipc_settings_writes.backend = settings_save_dst;
+		settings_dst_register(&ipc_settings_writes.store);
+	}
+}
+
+static void ipc_setting_invalidate_send(const char *name)
+{
+	int rc;
+	struct ipc_setting_invalidate_data *data;
+	uint8_t name_size = (name != NULL ? (strlen(name) + 1) : 0);
+
+	data = (struct ipc_setting_invalidate_data *)ipc_get_buffer();
+	data->name_size = name_size;
+	memcpy(data->name, name, name_size);
+
+	rc = ipc_send_buffer(IPC_OPCODE_SETTINGS_INVALIDATE, (sizeof(struct ipc_setting_invalidate_data) + name_size));
+
+	if (rc < 0) {
+		LOG_ERR("Setting %s not invalidated on client: %d", (name != NULL ? name : "(all)"), rc);
+	}
+}
+
+static void ipc_setting_notify_queue(const char *name);
+
+/* Sends changes made on the application core to the client, outside of the settings lock which the
+ * write hook runs under
+ */
+static void ipc_setting_changed_work_handler(struct k_work *work)
+{
+	bool overflow;
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	overflow = ipc_settings_writes.overflow;
+	ipc_settings_writes.overflow = false;
+	k_mutex_unlock(&key_state_lock);
+
+	if (overflow) {
+		ipc_setting_invalidate_send(NULL);
+	}
+
+	while (1) {
+		(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+
+		if (ipc_settings_writes.changed_count == 0) {
+			k_mutex_unlock(&key_state_lock);
+			break;
+		}
+
+		strcpy(ipc_settings_writes.name, ipc_settings_writes.changed[0]);
+		--ipc_settings_writes.changed_count;
+		memmove(ipc_settings_writes.changed[0], ipc_settings_writes.changed[1],
+			(ipc_settings_writes.changed_count * sizeof(ipc_settings_writes.changed[0])));
+		k_mutex_unlock(&key_state_lock);
+
+		if (!overflow) {
+			ipc_setting_invalidate_send(ipc_settings_writes.name);
+		}
+
+		/* Subscribers are sent the new value later, together with other changes */
+		ipc_setting_notify_queue(ipc_settings_writes.name);
+	}
+}
+
+/* Writes a key requested by the client to storage unless it already holds the same value, returns
+ * 1 if it was skipped. Key state, index and generation are updated by the write hook
+ */
+static int ipc_setting_write(const char *name, const uint8_t *value, uint16_t value_size)
+{
+	int rc;
+	bool unchanged;
+	int64_t start;
+	uint32_t save_us;
+
+	(void)k_mutex_lock(&client_write_lock, K_FOREVER);
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	unchanged = key_state_matches(key_state_get(name), value, value_size);
+	k_mutex_unlock(&key_state_lock);
+
+	if (unchanged) {
+		rc = 1;
+		goto finish;
+	}
+
+	ipc_settings_writes.client_writer = k_current_get();
+	start = k_uptime_ticks();
+	rc = settings_save_one(name, value, value_size);
+	save_us = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+	ipc_settings_writes.client_writer = NULL;
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	save_latency_add(save_us);
+	k_mutex_unlock(&key_state_lock);
+
+	ipc_setting_idle_defer();
+
+finish:
+	k_mutex_unlock(&client_write_lock);
+
+	return rc;
+}
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+static int ipc_setting_journal_roll_forward(void);
+
+/* Returns true if storage is known to already hold this value of a key */
+static bool ipc_setting_unchanged(const char *name, const uint8_t *value, uint16_t value_size)
+{
+	bool unchanged;
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	unchanged = key_state_matches(key_state_get(name), value, value_size);
+	k_mutex_unlock(&key_state_lock);
+
+	return unchanged;
+}
+#endif
+
+static int ipc_setting_callback_save(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)message;
+	struct ipc_setting_save_response_data data;
+	const char *name = NULL;
+
+	if (size >= sizeof(struct ipc_setting_save_data) &&
+	    size >= (sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size)) {
+		name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+	}
+
+	if (name == NULL || (setting->flags & IPC_SETTING_RECORD_FLAG_MORE)) {
+		rc = -EINVAL;
+	} else {
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+		/* Older values of a kept journal must not replace this one later */
+		rc = ipc_setting_journal_roll_forward();
+
+		if (rc == 0) {
+			rc = ipc_setting_write(name, &setting->setting[setting->name_size], setting->value_size);
+		}
+#else
+		rc = ipc_setting_write(name, &setting->setting[setting->name_size], setting->value_size);
+#endif
+	}
+
+	if (rc > 0) {
+		rc = 0;
+	}
+
+	data.rc = rc;
+
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SAVE, sizeof(data), (uint8_t *)&data);
+
+	return rc;
+}
+
+struct ipc_setting_read_data {
+	uint8_t *value;
+	uint16_t max_value_size;
+	int rc;
+};
+
+static int ipc_setting_read_loop(const char *name, size_t value_size, settings_read_cb read_cb, void *cb_arg, void *param)
+{
+	struct ipc_setting_read_data *read = (struct ipc_setting_read_data *)param;
+
+	/* Only the key itself is wanted, not the keys below it */
+	if (name != NULL) {
+		return 0;
+	}
+
+	read->rc = read_cb(cb_arg, read->value, MIN(value_size, read->max_value_size));
+
+	if (read->rc >= 0 && value_size > read->max_value_size) {
+		/* Value did not fit, it is not indexed or returned */
+		read->rc = -E2BIG;
+	}
+
+	return 1;
+}
+
+/* Reads a key from storage (using the index if enabled) rather than from a handler, so keys which
+ * only the client has a handler for can be loaded. Returns the size of the value, or -E2BIG if it
+ * is larger than max_value_size
+ */
+static int ipc_setting_read(const char *name, uint8_t *value, uint16_t max_value_size)
+{
+	int rc;
+	struct ipc_setting_read_data read = {
+		.value = value,
+		.max_value_size = max_value_size,
+		.rc = -ENOENT,
+	};
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	rc = index_load(name, value, max_value_size);
+
+	if (rc != -ESRCH) {
+		goto finish;
+	}
+#endif
+
+	/* The loop stops loading (returning 1) once it found the key */
+	rc = settings_load_subtree_direct(name, ipc_setting_read_loop, &read);
+
+	if (rc >= 0) {
+		rc = read.rc;
+	}
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	if (rc >= 0 || rc == -ENOENT) {
+		index_store(name, value, (rc >= 0 ? rc : 0), (rc >= 0));
+	}
+
+finish:
+#endif
+	if (rc == -ENOENT) {
+		/* Not in storage, the value might only exist at runtime */
+		rc = settings_runtime_get(name, value, max_value_size);
+	}
+
+	return rc;
+}
+
+static int ipc_setting_callback_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc = -EINVAL;
+	struct ipc_setting_load_data *setting = (struct ipc_setting_load_data *)message;
+	struct ipc_setting_load_response_data *data;
+
+	ipc_setting_idle_defer();
+
+	if (size >= sizeof(struct ipc_setting_load_data) && setting->name_size > 0 &&
+	    size >= (sizeof(struct ipc_setting_load_data) + setting->name_size) &&
+	    setting->name[(setting->name_size - 1)] == '\0') {
+		rc = ipc_setting_read(setting->name, ipc_settings_load_value,
+				      MIN(setting->max_value_size, sizeof(ipc_settings_load_value)));
+	}
+
+	/* Value is copied into the response in the IPC transmit buffer, which is sized to the value */
+	data = (struct ipc_setting_load_response_data *)ipc_get_buffer();
+	data->rc = rc;
+	data->value_size = (rc >= 0 ? rc : 0);
+	memcpy(data->setting, ipc_settings_load_value, data->value_size);
+
+	return ipc_send_buffer(IPC_OPCODE_SETTINGS_LOAD, (sizeof(struct ipc_setting_load_response_data) + data->value_size));
+}
+
+static int ipc_setting_batch_apply(void);
+
+static int ipc_setting_callback_commit(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_commit_response_data data;
+
+	/* Only keys which changed are written, saves outside of a session were already written */
+	rc = ipc_setting_batch_apply();
+	data.rc = rc;
+
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_COMMIT, sizeof(data), (uint8_t *)&data);
+
+	return rc;
+}
+
+static bool ipc_setting_batch_superseded(const uint8_t *records, uint16_t used, uint16_t offset,
+					 const struct ipc_setting_save_data *setting)
+{
+	offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+
+	while (offset < used) {
+		struct ipc_setting_save_data *later = (struct ipc_setting_save_data *)&records[offset];
+
+		if (later->name_size == setting->name_size &&
+		    (later->flags & IPC_SETTING_RECORD_FLAG_ID) == (setting->flags & IPC_SETTING_RECORD_FLAG_ID) &&
+		    memcmp(later->setting, setting->setting, setting->name_size) == 0) {
+			return true;
+		}
+
+		offset += sizeof(struct ipc_setting_save_data) + later->name_size + later->value_size;
+	}
+
+	return false;
+}
+
+/* Writes records which changed back to back, if a key is in the records more than once only the
+ * last value is written. The first error is returned
+ */
+static int ipc_setting_records_write(const uint8_t *records, uint16_t used)
+{
+	int rc = 0;
+	uint16_t offset = 0;
+	uint16_t written = 0;
+	uint16_t unchanged = 0;
+
+	while (offset < used) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&records[offset];
+		int save_rc = 1;
+
+		if (!(setting->flags & IPC_SETTING_RECORD_FLAG_MORE) &&
+		    !ipc_setting_batch_superseded(records, used, offset, setting)) {
+			save_rc = ipc_setting_write(ipc_setting_record_name(setting->setting, setting->name_size, setting->flags),
+						    &setting->setting[setting->name_size], setting->value_size);
+		}
+
+		if (save_rc == 0) {
+			++written;
+		} else if (save_rc > 0) {
+			++unchanged;
+		} else if (rc == 0) {
+			rc = save_rc;
+		}
+
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+	}
+
+	LOG_DBG("Session applied: %d written, %d unchanged, rc: %d", written, unchanged, rc);
+
+	return rc;
+}
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+/* Removes the staged records which would not be written (incomplete, superseded by a later value
+ * of the same key or already in storage), returns the number of records left
+ */
+static uint16_t ipc_setting_batch_compact(void)
+{
+	uint16_t offset = 0;
+	uint16_t changes = 0;
+
+	while (offset < ipc_settings_staging.used) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&ipc_settings_staging.buffer[offset];
+		uint16_t size = sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+
+		if (!(setting->flags & IPC_SETTING_RECORD_FLAG_MORE) &&
+		    !ipc_setting_batch_superseded(ipc_settings_staging.buffer, ipc_settings_staging.used, offset, setting) &&
+		    !ipc_setting_unchanged(ipc_setting_record_name(setting->setting, setting->name_size, setting->flags),
+					   &setting->setting[setting->name_size], setting->value_size)) {
+			offset += size;
+			++changes;
+			continue;
+		}
+
+		memmove(&ipc_settings_staging.buffer[offset], &ipc_settings_staging.buffer[(offset + size)],
+			(ipc_settings_staging.used - offset - size));
+		ipc_settings_staging.used -= size;
+	}
+
+	return changes;
+}
+
+/* Saves the staged records as the journal with the full name of each key, so that the journal
+ * does not depend on the setting IDs of the build which wrote it
+ */
+static int ipc_setting_journal_save(void)
+{
+	int rc;
+	uint8_t *journal;
+	uint16_t size = 0;
+	uint16_t offset = 0;
+	uint16_t used = 0;
+
+	while (offset < ipc_settings_staging.used) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&ipc_settings_staging.buffer[offset];
+		const char *name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+
+		if (name == NULL) {
+			return -EINVAL;
+		}
+
+		size += sizeof(struct ipc_setting_save_data) + strlen(name) + 1 + setting->value_size;
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+	}
+
+	journal = (uint8_t *)malloc(size);
+
+	if (journal == NULL) {
+		return -ENOMEM;
+	}
+
+	offset = 0;
+
+	while (offset < ipc_settings_staging.used) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&ipc_settings_staging.buffer[offset];
+		struct ipc_setting_save_data *record = (struct ipc_setting_save_data *)&journal[used];
+		const char *name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+
+		record->name_size = strlen(name) + 1;
+		record->flags = setting->flags & ~IPC_SETTING_RECORD_FLAG_ID;
+		record->value_size = setting->value_size;
+		memcpy(record->setting, name, record->name_size);
+		memcpy(&record->setting[record->name_size], &setting->setting[setting->name_size], setting->value_size);
+
+		used += sizeof(struct ipc_setting_save_data) + record->name_size + record->value_size;
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+	}
+
+	rc = settings_save_one(IPC_SETTING_JOURNAL_KEY, journal, used);
+	free(journal);
+
+	return rc;
+}
+#endif
+
+static int ipc_setting_batch_apply(void)
+{
+	int rc = ipc_settings_staging.rc;
+	bool journaled = false;
+
+	if (rc == 0 && ipc_settings_staging.partial) {
+		/* Last value is incomplete, nothing of the session is written */
+		rc = -EINVAL;
+	}
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+	if (rc == 0) {
+		/* An earlier session which was not fully written is finished first, so that its
+		 * journal cannot replace values of this session later
+		 */
+		rc = ipc_setting_journal_roll_forward();
+	}
+
+	if (rc == 0 && ipc_setting_batch_compact() > 1) {
+		/* Journal is a single storage entry, so after a restart either all or none of the
+		 * session's changed keys are written
+		 */
+		rc = ipc_setting_journal_save();
+
+		if (rc == 0) {
+			journaled = true;
+		} else {
+			LOG_ERR("Session journal not saved: %d", rc);
+		}
+	}
+#endif
+
+	if (rc == 0) {
+		rc = ipc_setting_records_write(ipc_settings_staging.buffer, ipc_settings_staging.used);
+	}
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+	if (journaled) {
+		if (rc == 0) {
+			(void)settings_delete(IPC_SETTING_JOURNAL_KEY);
+		} else {
+			/* Journal is kept, the remaining keys are written from it before the next
+			 * session or save, or at the next start
+			 */
+			ipc_settings_journal_pending = true;
+		}
+	}
+#endif
+
+	ipc_settings_staging.rc = 0;
+	ipc_settings_staging.used = 0;
+	ipc_settings_staging.partial = false;
+
+	return rc;
+}
+
+static int ipc_setting_batch_stage(const struct ipc_setting_save_batch_data *batch, uint16_t records_size)
+{
+	uint16_t offset = 0;
+	uint8_t i;
+
+	/* Check that every record is complete before staging any of them */
+	for (i = 0; i < batch->record_count; ++i) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&batch->records[offset];
+
+		if ((offset + sizeof(struct ipc_setting_save_data)) > records_size) {
+			return -EINVAL;
+		}
+
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+
+		if (offset > records_size ||
+		    ipc_setting_record_name(setting->setting, setting->name_size, setting->flags) == NULL) {
+			return -EINVAL;
+		}
+	}
+
+	offset = 0;
+
+	for (i = 0; i < batch->record_count; ++i) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&batch->records[offset];
+		struct ipc_setting_save_data *last = (struct ipc_setting_save_data *)&ipc_settings_staging.buffer[ipc_settings_staging.last];
+		uint16_t record_size = sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+
+		if (ipc_settings_staging.partial) {
+			/* Next part of the value of the last staged record */
+			if (setting->name_size != last->name_size ||
+			    (setting->flags & IPC_SETTING_RECORD_FLAG_ID) != (last->flags & IPC_SETTING_RECORD_FLAG_ID) ||
+			    memcmp(setting->setting, last->setting, setting->name_size) != 0 ||
+			    (last->value_size + setting->value_size) > UINT16_MAX) {
+				return -EINVAL;
+			}
+
+			if ((ipc_settings_staging.used + setting->value_size) > sizeof(ipc_settings_staging.buffer)) {
+				return -ENOMEM;
+			}
+
+			memcpy(&ipc_settings_staging.buffer[ipc_settings_staging.used],
+			       &setting->setting[setting->name_size], setting->value_size);
+			ipc_settings_staging.used += setting->value_size;
+			last->value_size += setting->value_size;
+			last->flags = setting->flags;
+		} else {
+			if ((ipc_settings_staging.used + record_size) > sizeof(ipc_settings_staging.buffer)) {
+				return -ENOMEM;
+			}
+
+			memcpy(&ipc_settings_staging.buffer[ipc_settings_staging.used], setting, record_size);
+			ipc_settings_staging.last = ipc_settings_staging.used;
+			ipc_settings_staging.used += record_size;
+		}
+
+		ipc_settings_staging.partial = (setting->flags & IPC_SETTING_RECORD_FLAG_MORE);
+		offset += record_size;
+	}
+
+	return 0;
+}
+
+static int ipc_setting_callback_save_batch(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_save_batch_data *batch = (struct ipc_setting_save_batch_data *)message;
+	struct ipc_setting_save_batch_response_data data;
+
+	if (size < sizeof(struct ipc_setting_save_batch_data)) {
+		data.rc = -EINVAL;
+		goto finish;
+	}
+
+	if (ipc_settings_staging.rc == 0) {
+		/* A failed session is not staged further, the error is returned when it ends */
+		ipc_settings_staging.rc = ipc_setting_batch_stage(batch, (size - sizeof(struct ipc_setting_save_batch_data)));
+	}
+
+	data.rc = ipc_settings_staging.rc;
+
+	if (batch->flags & IPC_SETTING_BATCH_FLAG_ABORT) {
+		ipc_settings_staging.rc = 0;
+		ipc_settings_staging.used = 0;
+		ipc_settings_staging.partial = false;
+		data.rc = 0;
+	} else if (batch->flags & (IPC_SETTING_BATCH_FLAG_APPLY | IPC_SETTING_BATCH_FLAG_COMMIT)) {
+		data.rc = ipc_setting_batch_apply();
+	}
+
+finish:
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SAVE_BATCH, sizeof(data), (uint8_t *)&data);
+
+	return rc;
+}
+
+static bool ipc_setting_prefix_valid(const uint8_t *prefix, uint8_t prefix_size, uint16_t size)
+{
+	return (size >= prefix_size && (prefix_size == 0 || prefix[(prefix_size - 1)] == '\0'));
+}
+
+static int ipc_setting_tree_count_loop(const char *name, size_t value_size, settings_read_cb read_cb, void *cb_arg, void *param)
+{
+	++ipc_settings_tree.count;
+
+	return 0;
+}
+
+static int ipc_setting_callback_tree_count(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_tree_count_data *request = (struct ipc_setting_tree_count_data *)message;
+	struct ipc_setting_tree_count_response_data data = { 0 };
+
+	if (size < sizeof(struct ipc_setting_tree_count_data) ||
+	    !ipc_setting_prefix_valid(request->prefix, request->prefix_size,
+				      (size - sizeof(struct ipc_setting_tree_count_data)))) {
+		data.rc = -EINVAL;
+		goto finish;
+	}
+
+	ipc_settings_tree.count = 0;
+	data.rc = settings_load_subtree_direct((request->prefix_size > 0 ? request->prefix : NULL),
+					       ipc_setting_tree_count_loop, NULL);
+	data.count = ipc_settings_tree.count;
+
+finish:
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_COUNT, sizeof(data), (uint8_t *)&data);
+
+	return rc;
+}
+
+static int ipc_setting_tree_load_loop(const char *name, size_t value_size, settings_read_cb read_cb, void *cb_arg, void *param)
+{
+	struct ipc_setting_tree_load_response_data *response = (struct ipc_setting_tree_load_response_data *)ipc_settings_tree.buffer;
+	struct ipc_setting_save_data *record;
+	uint16_t index = ipc_settings_tree.index++;
+	uint16_t prefix_size = (ipc_settings_tree.prefix != NULL ? strlen(ipc_settings_tree.prefix) : 0);
+	uint16_t part_size;
+	uint16_t name_size;
+	uint16_t record_size;
+	uint16_t id;
+	char full_name[(SETTINGS_MAX_NAME_LEN + 1)];
+
+	if (index < ipc_settings_tree.cursor || ipc_settings_tree.full) {
+		return 0;
+	}
+
+	if (name == NULL) {
+		/* Setting is the prefix itself */
+		name = "";
+	}
+
+	part_size = strlen(name);
+
+	/* Names are relative to the prefix, the full name (or its ID) is sent */
+	if ((prefix_size + 1 + part_size + 1) > sizeof(full_name)) {
+		LOG_ERR("Setting %s name too long for tree load", name);
+		return 0;
+	}
+
+	if (prefix_size > 0) {
+		memcpy(full_name, ipc_settings_tree.prefix, prefix_size);
+
+		if (part_size > 0) {
+			full_name[prefix_size] = '/';
+			++prefix_size;
+		}
+	}
+
+	memcpy(&full_name[prefix_size], name, (part_size + 1));
+	name_size = ipc_setting_record_name_size(full_name, &id);
+	record_size = sizeof(struct ipc_setting_save_data) + name_size + value_size;
+
+	if (value_size > UINT16_MAX ||
+	    record_size > (sizeof(ipc_settings_tree.buffer) - sizeof(struct ipc_setting_tree_load_response_data))) {
+		LOG_ERR("Setting %s too large for tree load page: %d", name, record_size);
+		return 0;
+	}
+
+	if ((ipc_settings_tree.used + record_size) > sizeof(ipc_settings_tree.buffer)) {
+		/* Page is full, the client continues from this setting with the next request */
+		ipc_settings_tree.full = true;
+		response->next_cursor = index;
+		return 0;
+	}
+
+	record = (struct ipc_setting_save_data *)&ipc_settings_tree.buffer[ipc_settings_tree.used];
+	record->name_size = name_size;
+	record->flags = ipc_setting_record_name_put(record->setting, full_name, id, name_size);
+	record->value_size = value_size;
+	(void)read_cb(cb_arg, &record->setting[name_size], value_size);
+
+	ipc_settings_tree.used += record_size;
+	++response->record_count;
+
+	return 0;
+}
+
+static int ipc_setting_callback_tree_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_tree_load_data *request = (struct ipc_setting_tree_load_data *)message;
+	struct ipc_setting_tree_load_response_data *response = (struct ipc_setting_tree_load_response_data *)ipc_settings_tree.buffer;
+
+	ipc_setting_idle_defer();
+	ipc_settings_tree.index = 0;
+	ipc_settings_tree.used = sizeof(struct ipc_setting_tree_load_response_data);
+	ipc_settings_tree.full = false;
+	response->record_count = 0;
+	response->flags = 0;
+
+	if (size < sizeof(struct ipc_setting_tree_load_data) ||
+	    !ipc_setting_prefix_valid(request->prefix, request->prefix_size,
+				      (size - sizeof(struct ipc_setting_tree_load_data)))) {
+		response->rc = -EINVAL;
+		response->flags = IPC_SETTING_TREE_FLAG_END;
+		response->next_cursor = 0;
+		goto finish;
+	}
+
+	ipc_settings_tree.prefix = (request->prefix_size > 0 ? request->prefix : NULL);
+	ipc_settings_tree.cursor = request->cursor;
+
+	response->rc = settings_load_subtree_direct(ipc_settings_tree.prefix, ipc_setting_tree_load_loop, NULL);
+
+	if (!ipc_settings_tree.full) {
+		response->flags = IPC_SETTING_TREE_FLAG_END;
+		response->next_cursor = ipc_settings_tree.index;
+	}
+
+	ipc_settings_tree.prefix = NULL;
+
+finish:
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_LOAD, ipc_settings_tree.used, ipc_settings_tree.buffer);
+
+	return rc;
+}
+
+static int ipc_setting_callback_boot_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_boot_load_ack_data *ack = (struct ipc_setting_boot_load_ack_data *)message;
+
+	if (size < sizeof(struct ipc_setting_boot_load_ack_data)) {
+		return -EINVAL;
+	}
+
+	if (ack->seq != ipc_settings_boot_load.ack_seq) {
+		LOG_WRN("Boot load ack for frame %d, expected %d", ack->seq, ipc_settings_boot_load.ack_seq);
+	}
+
+	ipc_settings_boot_load.ack_seq = ack->seq + 1;
+	k_sem_give(&ipc_settings_boot_load.credits);
+
+	return 0;
+}
+
+static void ipc_setting_boot_load_reset(void)
+{
+	struct ipc_setting_boot_load_frame_data *frame = (struct ipc_setting_boot_load_frame_data *)ipc_settings_boot_load.buffer;
+
+	frame->record_count = 0;
+	ipc_settings_boot_load.used = sizeof(struct ipc_setting_boot_load_frame_data);
+}
+
+static int ipc_setting_boot_load_send(uint8_t flags)
+{
+	int rc;
+	struct ipc_setting_boot_load_frame_data *frame = (struct ipc_setting_boot_load_frame_data *)ipc_settings_boot_load.buffer;
+
+	rc = k_sem_take(&ipc_settings_boot_load.credits, IPC_SETTING_BOOT_LOAD_ACK_TIMEOUT);
+
+	if (rc != 0) {
+		LOG_ERR("Boot load frame %d not acknowledged", ipc_settings_boot_load.ack_seq);
+		return -ETIMEDOUT;
+	}
+
+	frame->epoch = ipc_settings_generation.epoch;
+	frame->generation = ipc_settings_boot_load.generation;
+	frame->seq = ipc_settings_boot_load.seq++;
+	frame->flags = flags | ipc_settings_boot_load.flags;
+
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_BOOT_LOAD, ipc_settings_boot_load.used, ipc_settings_boot_load.buffer);
+
+	if (rc < 0) {
+		/* Frame was not sent so will not be acknowledged */
+		k_sem_give(&ipc_settings_boot_load.credits);
+	} else {
+		rc = 0;
+		++ipc_settings_boot_load.frames;
+		ipc_settings_boot_load.bytes += ipc_settings_boot_load.used;
+	}
+
+	ipc_setting_boot_load_reset();
+
+	return rc;
+}
+
+/* Appends a setting to the boot load, split over several frames if needed. A value size of 0 is
+ * a deleted setting, which tells the client to remove its copy
+ */
+static int ipc_setting_boot_load_add(const char *full_name, const uint8_t *value, uint16_t value_size)
+{
+	int rc = 0;
+	struct ipc_setting_boot_load_frame_data *frame = (struct ipc_setting_boot_load_frame_data *)ipc_settings_boot_load.buffer;
+	struct ipc_setting_boot_load_data *data;
+	uint16_t id;
+	uint8_t name_size;
+	uint16_t header_size;
+	uint16_t offset = 0;
+
+	name_size = ipc_setting_record_name_size(full_name, &id);
+	header_size = sizeof(struct ipc_setting_boot_load_data) + name_size;
+
+	while (1) {
+		uint16_t space = sizeof(ipc_settings_boot_load.buffer) - ipc_settings_boot_load.used;
+		uint16_t chunk;
+
+		if (space < (header_size + MIN((value_size - offset), IPC_SETTING_MIN_CHUNK_SIZE))) {
+			rc = ipc_setting_boot_load_send(0);
+
+			if (rc != 0) {
+				return rc;
+			}
+
+			continue;
+		}
+
+		chunk = MIN((value_size - offset), (space - header_size));
+
+		data = (struct ipc_setting_boot_load_data *)&ipc_settings_boot_load.buffer[ipc_settings_boot_load.used];
+		data->name_size = name_size;
+		data->flags = ipc_setting_record_name_put(data->setting, full_name, id, name_size) |
+			      ((offset + chunk) < value_size ? IPC_SETTING_RECORD_FLAG_MORE : 0);
+		data->value_size = chunk;
+
+		if (chunk > 0) {
+			memcpy(&data->setting[name_size], &value[offset], chunk);
+		}
+
+		ipc_settings_boot_load.used += header_size + chunk;
+		++frame->record_count;
+		offset += chunk;
+
+		if (offset >= value_size) {
+			break;
+		}
+	}
+
+	/* Value is known to be in storage, an identical save does not need to write it again */
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	key_state_set(key_state_get(full_name), value, value_size);
+	k_mutex_unlock(&key_state_lock);
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	index_store(full_name, value, value_size, (value_size > 0));
+#endif
+
+	++ipc_settings_boot_load.records;
+
+	return rc;
+}
+
+static int ipc_setting_boot_load_loop(const char *name, size_t value_size, settings_read_cb read_cb, void *cb_arg, void *param)
+{
+	int rc;
+	uint8_t *key = (uint8_t *)param;
+	uint8_t *value = NULL;
+	uint16_t key_size = strlen(key) + 1;
+	uint16_t part_size = (name != NULL ? (strlen(name) + 1) : 0);
+	uint16_t id;
+	char full_name[(SETTINGS_MAX_NAME_LEN + 1)];
+
+	if ((key_size + part_size) > sizeof(full_name)) {
+		LOG_ERR("Setting under %s name too long for boot load", key);
+		return 0;
+	}
+
+	/* Name is NULL for the setting which is the key itself */
+	memcpy(full_name, key, key_size);
+
+	if (name != NULL) {
+		full_name[(key_size - 1)] = '/';
+		memcpy(&full_name[key_size], name, part_size);
+	}
+	if (ipc_settings_boot_load.since > 0) {
+		uint32_t generation;
+
+		(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+		generation = generation_get(crc32_ieee((const uint8_t *)full_name, strlen(full_name)));
+		k_mutex_unlock(&key_state_lock);
+
+		if (generation <= ipc_settings_boot_load.since) {
+			/* Client already has this value */
+			return 0;
+		}
+	}
+
+	if (value_size > UINT16_MAX ||
+	    (sizeof(struct ipc_setting_boot_load_data) + ipc_setting_record_name_size(full_name, &id) +
+	     MIN(value_size, IPC_SETTING_MIN_CHUNK_SIZE)) >
+	    (sizeof(ipc_settings_boot_load.buffer) - sizeof(struct ipc_setting_boot_load_frame_data))) {
+		LOG_ERR("Setting %s too large for boot load: %d", full_name, value_size);
+		return 0;
+	}
+
+	if (value_size > 0) {
+		/* Value is read in full, it might be split over several frames */
+		value = (uint8_t *)malloc(value_size);
+
+		if (value == NULL) {
+			LOG_ERR("Setting %s not sent, no memory for %d bytes", full_name, value_size);
+			return 0;
+		}
+
+		(void)read_cb(cb_arg, value, value_size);
+	}
+
+	rc = ipc_setting_boot_load_add(full_name, value, value_size);
+	free(value);
+
+	return rc;
+}
+
+/* Appends the settings under key which were deleted since the client's generation */
+static int ipc_setting_boot_load_tombstones(const char *key)
+{
+	int rc = 0;
+	uint8_t i;
+	char name[(SETTINGS_MAX_NAME_LEN + 1)];
+
+	for (i = 0; i < CONFIG_IPC_SETTINGS_TOMBSTONES; ++i) {
+		struct ipc_setting_tombstone *tombstone = &ipc_settings_generation.tombstones[i];
+		bool send = false;
+
+		/* Name is copied out so that the lock is not held while frames are sent */
+		(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+
+		if (tombstone->generation > ipc_settings_boot_load.since &&
+		    settings_name_steq(tombstone->name, key, NULL)) {
+			strcpy(name, tombstone->name);
+			send = true;
+		}
+
+		k_mutex_unlock(&key_state_lock);
+
+		if (send) {
+			rc = ipc_setting_boot_load_add(name, NULL, 0);
+
+			if (rc != 0) {
+				break;
+			}
+		}
+	}
+
+	return rc;
+}
+
+static int ipc_setting_boot_load_since(uint8_t *key, uint32_t since)
+{
+	int rc;
+	int send_rc;
+	uint8_t i;
+	uint8_t credits = 0;
+	int64_t start = k_uptime_ticks();
+
+	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
+
+	/* Changes made while the boot load runs might not be included, they are sent again the next
+	 * time as they have a later generation
+	 */
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+	ipc_settings_boot_load.generation = ipc_settings_generation.generation;
+	k_mutex_unlock(&key_state_lock);
+
+	ipc_settings_boot_load.since = since;
+	ipc_settings_boot_load.flags = (since == 0 ? IPC_SETTING_BOOT_LOAD_FLAG_FULL : 0);
+	ipc_settings_boot_load.seq = 0;
+	ipc_settings_boot_load.ack_seq = 0;
+	ipc_settings_boot_load.records = 0;
+	ipc_settings_boot_load.frames = 0;
+	ipc_settings_boot_load.bytes = 0;
+	ipc_setting_boot_load_reset();
+
+	rc = settings_load_subtree_direct(key, ipc_setting_boot_load_loop, key);
+
+	if (rc == 0 && since > 0) {
+		rc = ipc_setting_boot_load_tombstones(key);
+	}
+
+	/* Last frame is always sent so that the client knows that boot load has finished */
+	send_rc = ipc_setting_boot_load_send(IPC_SETTING_BOOT_LOAD_FLAG_END);
+
+	if (rc == 0) {
+		rc = send_rc;
+	}
+
+	/* Wait for all outstanding frames to be acknowledged */
+	for (i = 0; i < CONFIG_IPC_SETTINGS_BOOT_LOAD_WINDOW; ++i) {
+		if (k_sem_take(&ipc_settings_boot_load.credits, IPC_SETTING_BOOT_LOAD_ACK_TIMEOUT) != 0) {
+			LOG_ERR("Boot load frame %d not acknowledged", ipc_settings_boot_load.ack_seq);
+
+			if (rc == 0) {
+				rc = -ETIMEDOUT;
+			}
+
+			break;
+		}
+
+		++credits;
+	}
+
+	while (credits > 0) {
+		k_sem_give(&ipc_settings_boot_load.credits);
+		--credits;
+	}
+
+	LOG_INF("Boot load of %s since generation %u: %d records in %d frames (%d bytes) took %lld us, rc: %d",
+		key, since, ipc_settings_boot_load.records, ipc_settings_boot_load.frames,
+		ipc_settings_boot_load.bytes, k_ticks_to_us_floor64(k_uptime_ticks() - start), rc);
+
+	k_sem_give(&ipc_settings_data.busy);
+	return rc;
+}
+
+int ipc_setting_boot_load(uint8_t *key)
+{
+	return ipc_setting_boot_load_since(key, 0);
+}
+
+static void ipc_setting_boot_sync_work_handler(struct k_work *work)
+{
+	uint32_t since = 0;
+
+	ipc_settings_boot_sync_request.pending = false;
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+
+	/* Only changes are sent if the client has every change up to the floor of this server boot */
+	if (ipc_settings_boot_sync_request.epoch == ipc_settings_generation.epoch &&
+	    ipc_settings_boot_sync_request.generation >= ipc_settings_generation.floor &&
+	    ipc_settings_boot_sync_request.generation <= ipc_settings_generation.generation) {
+		since = ipc_settings_boot_sync_request.generation;
+	}
+
+	k_mutex_unlock(&key_state_lock);
+
+	(void)ipc_setting_boot_load_since(ipc_settings_boot_sync_request.key, since);
+}
+
+static int ipc_setting_callback_boot_sync(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_boot_sync_data *request = (struct ipc_setting_boot_sync_data *)message;
+
+	if (size < sizeof(struct ipc_setting_boot_sync_data) || request->key_size == 0 ||
+	    request->key_size > sizeof(ipc_settings_boot_sync_request.key) ||
+	    size < (sizeof(struct ipc_setting_boot_sync_data) + request->key_size) ||
+	    request->key[(request->key_size - 1)] != '\0') {
+		LOG_ERR("Invalid boot sync request");
+		return -EINVAL;
+	}
+
+	/* Client has restarted, so subscriptions and changes which were not yet notified are dropped */
+	(void)k_mutex_lock(&ipc_settings_notify.lock, K_FOREVER);
+	memset(ipc_settings_notify.prefixes, 0, sizeof(ipc_settings_notify.prefixes));
+	ipc_settings_notify.pending_count = 0;
+	k_mutex_unlock(&ipc_settings_notify.lock);
+
+	/* Boot load waits for acknowledgements which arrive on this thread, so runs from a work item */
+	ipc_settings_boot_sync_request.epoch = request->epoch;
+	ipc_settings_boot_sync_request.generation = request->generation;
+	memcpy(ipc_settings_boot_sync_request.key, request->key, request->key_size);
+	ipc_settings_boot_sync_request.pending = true;
+
+	if (ipc_settings_boot_sync_request.ready) {
+		(void)k_work_submit_to_queue(&ipc_settings_boot_sync_work_q, &ipc_settings_boot_sync_work);
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+static int ipc_setting_journal_size_loop(const char *name, size_t value_size, settings_read_cb read_cb,
+					 void *cb_arg, void *param)
+{
+	if (name != NULL) {
+		return 0;
+	}
+
+	*(size_t *)param = value_size;
+
+	return 1;
+}
+
+/* Writes the keys of a session which was cut off by a restart or failed to be written. The
+ * journal is deleted once all of them have been written, or if it is not valid
+ */
+static int ipc_setting_journal_recover(void)
+{
+	int rc;
+	uint8_t *records;
+	size_t size = 0;
+	struct ipc_setting_read_data read = {
+		.rc = -ENOENT,
+	};
+	uint16_t offset = 0;
+
+	/* Names make the journal larger than the staged records, it is read in one allocation */
+	(void)settings_load_subtree_direct(IPC_SETTING_JOURNAL_KEY, ipc_setting_journal_size_loop, &size);
+
+	if (size == 0) {
+		ipc_settings_journal_pending = false;
+		return 0;
+	}
+
+	records = (uint8_t *)malloc(size);
+	read.value = records;
+	read.max_value_size = size;
+
+	if (records == NULL) {
+		LOG_ERR("No memory to check session journal");
+		return -ENOMEM;
+	}
+
+	rc = settings_load_subtree_direct(IPC_SETTING_JOURNAL_KEY, ipc_setting_read_loop, &read);
+
+	if (rc >= 0) {
+		rc = read.rc;
+	}
+
+	if (rc == -ENOENT) {
+		rc = 0;
+		goto finish;
+	}
+
+	/* Every record is checked before any of them is written */
+	while (rc > 0 && offset < rc) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&records[offset];
+
+		if ((offset + sizeof(struct ipc_setting_save_data)) > rc ||
+		    (offset + sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size) > rc ||
+		    (setting->flags & (IPC_SETTING_RECORD_FLAG_MORE | IPC_SETTING_RECORD_FLAG_ID)) ||
+		    ipc_setting_record_name(setting->setting, setting->name_size, setting->flags) == NULL) {
+			break;
+		}
+
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+	}
+
+	if (rc <= 0 || offset != rc) {
+		LOG_ERR("Session journal not valid: %d", rc);
+		rc = 0;
+	} else {
+		rc = ipc_setting_records_write(records, rc);
+		LOG_WRN("Interrupted session written from journal, rc: %d", rc);
+	}
+
+	if (rc == 0) {
+		(void)settings_delete(IPC_SETTING_JOURNAL_KEY);
+	}
+
+finish:
+	free(records);
+
+	ipc_settings_journal_pending = (rc != 0);
+
+	return rc;
+}
+
+/* Finishes writing a journal which was kept after a failed write, before anything newer is written */
+static int ipc_setting_journal_roll_forward(void)
+{
+	if (!ipc_settings_journal_pending) {
+		return 0;
+	}
+
+	return ipc_setting_journal_recover();
+}
+#endif
+
+void ipc_setting_server_ready(void)
+{
+	ipc_setting_store_install();
+
+#if defined(CONFIG_IPC_SETTINGS_JOURNAL)
+	(void)ipc_setting_journal_recover();
+#endif
+
+	(void)k_mutex_lock(&key_state_lock, K_FOREVER);
+
+	do {
+		ipc_settings_generation.epoch = sys_rand32_get();
+	} while (ipc_settings_generation.epoch == 0);
+
+	k_mutex_unlock(&key_state_lock);
+
+	ipc_settings_boot_sync_request.ready = true;
+
+	if (ipc_settings_boot_sync_request.pending) {
+		(void)k_work_submit_to_queue(&ipc_settings_boot_sync_work_q, &ipc_settings_boot_sync_work);
+	}
+}
+
+/* Returns true if a setting is under a subscribed prefix, ipc_settings_notify.lock must be held */
+static bool ipc_setting_notify_subscribed(const char *name)
+{
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_notify.prefixes); ++i) {
+		struct ipc_setting_subscribed_prefix *entry = &ipc_settings_notify.prefixes[i];
+
+		if (entry->count > 0 && (entry->prefix[0] == '\0' ||
+					 settings_name_steq(name, entry->prefix, NULL))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int ipc_setting_notify_send(void)
+{
+	int rc;
+
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_NOTIFY, ipc_settings_notify.used, ipc_settings_notify.buffer);
+
+	if (rc < 0) {
+		LOG_ERR("Settings change notification not sent: %d", rc);
+	}
+
+	ipc_settings_notify.used = 0;
+
+	return rc;
+}
+
+/* Sends the current values of the pending settings, ipc_settings_notify.lock must be held */
+static void ipc_setting_notify_flush(void)
+{
+	struct ipc_setting_notify_data *data = (struct ipc_setting_notify_data *)ipc_settings_notify.buffer;
+	uint8_t i;
+
+	ipc_settings_notify.used = 0;
+
+	for (i = 0; i < ipc_settings_notify.pending_count; ++i) {
+		const char *name = ipc_settings_notify.pending[i];
+		struct ipc_setting_save_data *record;
+		uint16_t id;
+		uint8_t name_size = ipc_setting_record_name_size(name, &id);
+		uint16_t max_value_size = sizeof(ipc_settings_notify.buffer) - sizeof(struct ipc_setting_notify_data) -
+					  sizeof(struct ipc_setting_save_data) - name_size;
+		uint16_t record_size;
+		int rc;
+
+		rc = ipc_setting_read(name, ipc_settings_notify.value, max_value_size);
+
+		if (rc == -ENOENT) {
+			rc = 0;
+		}
+
+		if (rc == -E2BIG) {
+			/* Client has only been told to drop its cached copy */
+			LOG_WRN("Setting %s too large to notify", name);
+			continue;
+		}
+
+		if (rc < 0) {
+			LOG_ERR("Setting %s not notified: %d", name, rc);
+			continue;
+		}
+
+		record_size = sizeof(struct ipc_setting_save_data) + name_size + rc;
+
+		if (ipc_settings_notify.used > 0 &&
+		    (ipc_settings_notify.used + record_size) > sizeof(ipc_settings_notify.buffer)) {
+			(void)ipc_setting_notify_send();
+		}
+
+		if (ipc_settings_notify.used == 0) {
+			data->record_count = 0;
+			ipc_settings_notify.used = sizeof(struct ipc_setting_notify_data);
+		}
+
+		record = (struct ipc_setting_save_data *)&ipc_settings_notify.buffer[ipc_settings_notify.used];
+		record->name_size = name_size;
+		record->flags = ipc_setting_record_name_put(record->setting, name, id, name_size);
+		record->value_size = rc;
+		memcpy(&record->setting[name_size], ipc_settings_notify.value, rc);
+
+		ipc_settings_notify.used += record_size;
+		++data->record_count;
+	}
+
+	if (ipc_settings_notify.used > 0) {
+		(void)ipc_setting_notify_send();
+	}
+
+	ipc_settings_notify.pending_count = 0;
+}
+
+static void ipc_setting_notify_work_handler(struct k_work *work)
+{
+	(void)k_mutex_lock(&ipc_settings_notify.lock, K_FOREVER);
+	ipc_setting_notify_flush();
+	k_mutex_unlock(&ipc_settings_notify.lock);
+}
+
+/* Adds a changed setting to the next notification if the client subscribed to it */
+static void ipc_setting_notify_queue(const char *name)
+{
+	uint8_t i;
+
+	if ((strlen(name) + 1) > sizeof(ipc_settings_notify.pending[0])) {
+		return;
+	}
+
+	(void)k_mutex_lock(&ipc_settings_notify.lock, K_FOREVER);
+
+	if (!ipc_setting_notify_subscribed(name)) {
+		goto finish;
+	}
+
+	for (i = 0; i < ipc_settings_notify.pending_count; ++i) {
+		if (strcmp(ipc_settings_notify.pending[i], name) == 0) {
+			/* Already pending, the latest value is read when the notification is sent */
+			goto finish;
+		}
+	}
+
+	if (ipc_settings_notify.pending_count == ARRAY_SIZE(ipc_settings_notify.pending)) {
+		/* No space to collect more changes, send the pending ones now */
+		ipc_setting_notify_flush();
+	}
+
+	strcpy(ipc_settings_notify.pending[ipc_settings_notify.pending_count], name);
+	++ipc_settings_notify.pending_count;
+
+	/* Not rescheduled if already scheduled, so a notification is not delayed by later changes */
+	(void)k_work_schedule(&ipc_settings_notify_work, K_MSEC(CONFIG_IPC_SETTINGS_NOTIFY_DELAY));
+
+finish:
+	k_mutex_unlock(&ipc_settings_notify.lock);
+}
+
+static int ipc_setting_callback_subscribe(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_subscribe_data *request = (struct ipc_setting_subscribe_data *)message;
+	struct ipc_setting_subscribe_response_data data;
+	struct ipc_setting_subscribed_prefix *found = NULL;
+	struct ipc_setting_subscribed_prefix *unused = NULL;
+	const char *prefix;
+	uint8_t i;
+
+	if (size < sizeof(struct ipc_setting_subscribe_data) ||
+	    request->prefix_size > sizeof(found->prefix) ||
+	    !ipc_setting_prefix_valid(request->prefix, request->prefix_size,
+				      (size - sizeof(struct ipc_setting_subscribe_data)))) {
+		data.rc = -EINVAL;
+		goto finish;
+	}
+
+	prefix = (request->prefix_size > 0 ? (const char *)request->prefix : "");
+	(void)k_mutex_lock(&ipc_settings_notify.lock, K_FOREVER);
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_notify.prefixes); ++i) {
+		struct ipc_setting_subscribed_prefix *entry = &ipc_settings_notify.prefixes[i];
+
+		if (entry->count == 0) {
+			if (unused == NULL) {
+				unused = entry;
+			}
+		} else if (strcmp(entry->prefix, prefix) == 0) {
+			found = entry;
+			break;
+		}
+	}
+
+	if (request->flags & IPC_SETTING_SUBSCRIBE_FLAG_REMOVE) {
+		if (found != NULL) {
+			--found->count;
+			data.rc = 0;
+		} else {
+			data.rc = -ENOENT;
+		}
+	} else if (found != NULL) {
+		++found->count;
+		data.rc = 0;
+	} else if (unused != NULL) {
+		strcpy(unused->prefix, prefix);
+		unused->count = 1;
+		data.rc = 0;
+	} else {
+		data.rc = -ENOMEM;
+	}
+
+	k_mutex_unlock(&ipc_settings_notify.lock);
+
+finish:
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SUBSCRIBE, sizeof(data), (uint8_t *)&data);
+
+	return rc;
+}
+
+#endif
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+static struct ipc_setting_cache_entry *cache_find(const uint8_t *name, uint8_t name_size)
+{
+	uint32_t name_hash = crc32_ieee(name, name_size);
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_cache.entries); ++i) {
+		struct ipc_setting_cache_entry *entry = &ipc_settings_cache.entries[i];
+
+		if (entry->used && entry->name_hash == name_hash && entry->name_size == name_size &&
+		    memcmp(&ipc_settings_cache.arena[entry->offset], name, name_size) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void cache_remove(struct ipc_setting_cache_entry *entry)
+{
+	uint16_t entry_size = entry->name_size + entry->value_size;
+	uint16_t end = entry->offset + entry_size;
+	uint8_t i;
+
+	memmove(&ipc_settings_cache.arena[entry->offset], &ipc_settings_cache.arena[end],
+		(ipc_settings_cache.used - end));
+	ipc_settings_cache.used -= entry_size;
+	entry->used = false;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_cache.entries); ++i) {
+		struct ipc_setting_cache_entry *other = &ipc_settings_cache.entries[i];
+
+		if (other->used && other->offset > entry->offset) {
+			other->offset -= entry_size;
+		}
+	}
+}
+
+static void cache_clear(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_cache.entries); ++i) {
+		ipc_settings_cache.entries[i].used = false;
+	}
+
+	ipc_settings_cache.used = 0;
+}
+
+static void cache_store(const uint8_t *name, const uint8_t *value, uint16_t value_size)
+{
+	struct ipc_setting_cache_entry *entry;
+	struct ipc_setting_cache_entry *oldest;
+	uint8_t name_size = strlen(name) + 1;
+	uint32_t entry_size = name_size + value_size;
+	uint8_t i;
+
+	(void)k_mutex_lock(&ipc_settings_cache.lock, K_FOREVER);
+	entry = cache_find(name, name_size);
+
+	if (entry != NULL) {
+		cache_remove(entry);
+	}
+
+	if (entry_size > sizeof(ipc_settings_cache.arena)) {
+		goto finish;
+	}
+
+	/* Remove least recently used entries until there is a free entry and enough space */
+	while (1) {
+		entry = NULL;
+		oldest = NULL;
+
+		for (i = 0; i < ARRAY_SIZE(ipc_settings_cache.entries); ++i) {
+			struct ipc_setting_cache_entry *check = &ipc_settings_cache.entries[i];
+
+			if (!check->used) {
+				if (entry == NULL) {
+					entry = check;
+				}
+			} else if (oldest == NULL || check->last_used < oldest->last_used) {
+				oldest = check;
+			}
+		}
+
+		if (entry != NULL && (ipc_settings_cache.used + entry_size) <= sizeof(ipc_settings_cache.arena)) {
+			break;
+		}
+
+		cache_remove(oldest);
+		++ipc_settings_cache.stats.evictions;
+	}
+
+	entry->name_hash = crc32_ieee(name, name_size);
+	entry->last_used = ++ipc_settings_cache.counter;
+	entry->offset = ipc_settings_cache.used;
+	entry->name_size = name_size;
+	entry->value_size = value_size;
+	entry->used = true;
+	memcpy(&ipc_settings_cache.arena[entry->offset], name, name_size);
+	memcpy(&ipc_settings_cache.arena[(entry->offset + name_size)], value, value_size);
+	ipc_settings_cache.used += entry_size;
+
+finish:
+	k_mutex_unlock(&ipc_settings_cache.lock);
+}
+
+static void cache_invalidate(const uint8_t *name)
+{
+	struct ipc_setting_cache_entry *entry;
+
+	(void)k_mutex_lock(&ipc_settings_cache.lock, K_FOREVER);
+
+	if (name == NULL) {
+		cache_clear();
+	} else {
+		entry = cache_find(name, (strlen(name) + 1));
+
+		if (entry != NULL) {
+			cache_remove(entry);
+		}
+	}
+
+	++ipc_settings_cache.stats.invalidations;
+	k_mutex_unlock(&ipc_settings_cache.lock);
+}
+
+/* Returns the size of the value if it is cached, -E2BIG if it is larger than max_value_size,
+ * otherwise -ENOENT
+ */
+static int cache_load(const uint8_t *name, uint8_t *value, uint16_t max_value_size)
+{
+	int rc = -ENOENT;
+	struct ipc_setting_cache_entry *entry;
+
+	(void)k_mutex_lock(&ipc_settings_cache.lock, K_FOREVER);
+	entry = cache_find(name, (strlen(name) + 1));
+
+	if (entry != NULL) {
+		if (entry->value_size > max_value_size) {
+			rc = -E2BIG;
+		} else {
+			rc = entry->value_size;
+			memcpy(value, &ipc_settings_cache.arena[(entry->offset + entry->name_size)], rc);
+		}
+
+		entry->last_used = ++ipc_settings_cache.counter;
+		++ipc_settings_cache.stats.hits;
+	} else {
+		++ipc_settings_cache.stats.misses;
+	}
+
+	k_mutex_unlock(&ipc_settings_cache.lock);
+
+	return rc;
+}
+
+int ipc_setting_cache_stats_get(struct ipc_setting_cache_stats *stats)
+{
+	uint8_t i;
+
+	(void)k_mutex_lock(&ipc_settings_cache.lock, K_FOREVER);
+	*stats = ipc_settings_cache.stats;
+	stats->entries = 0;
+	stats->used = ipc_settings_cache.used;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_settings_cache.entries); ++i) {
+		if (ipc_settings_cache.entries[i].used) {
+			++stats->entries;
+		}
+	}
+
+	k_mutex_unlock(&ipc_settings_cache.lock);
+
+	return 0;
+}
+
+void ipc_setting_cache_clear(void)
+{
+	(void)k_mutex_lock(&ipc_settings_cache.lock, K_FOREVER);
+	cache_clear();
+	k_mutex_unlock(&ipc_settings_cache.lock);
+}
+#endif
+
+#if defined(CONFIG_IPC_SETTINGS_CLIENT)
+static int ipc_setting_callback_save(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_save_response_data *data = (struct ipc_setting_save_response_data *)message;
+
+	ipc_settings_data.rc = data->rc;
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_load_response_data *data = (struct ipc_setting_load_response_data *)message;
+
+	/* Value is copied from the IPC receive buffer straight to the buffer of the caller */
+	if (size < sizeof(struct ipc_setting_load_response_data) ||
+	    size < (sizeof(struct ipc_setting_load_response_data) + data->value_size)) {
+		ipc_settings_data.rc = -EINVAL;
+	} else if (data->rc >= 0 && (ipc_settings_data.load_pointer == NULL ||
+				     data->value_size > ipc_settings_data.load_size)) {
+		ipc_settings_data.rc = -EMSGSIZE;
+	} else {
+		ipc_settings_data.rc = data->rc;
+
+		if (data->rc >= 0) {
+			memcpy(ipc_settings_data.load_pointer, data->setting, data->value_size);
+			ipc_settings_data.rc = data->value_size;
+		}
+	}
+
+	ipc_settings_data.load_pointer = NULL;
+	ipc_settings_data.load_size = 0;
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_commit(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_commit_response_data *data = (struct ipc_setting_commit_response_data *)message;
+
+	ipc_settings_data.rc = data->rc;
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_save_batch(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_save_batch_response_data *data = (struct ipc_setting_save_batch_response_data *)message;
+
+	ipc_settings_data.rc = data->rc;
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_tree_count(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_tree_count_response_data *data = (struct ipc_setting_tree_count_response_data *)message;
+
+	if (size < sizeof(struct ipc_setting_tree_count_response_data)) {
+		ipc_settings_data.rc = -EINVAL;
+	} else {
+		ipc_settings_data.rc = data->rc;
+		ipc_settings_tree.count = data->count;
+	}
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_tree_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	if (size < sizeof(struct ipc_setting_tree_load_response_data) || size > sizeof(ipc_settings_tree.buffer)) {
+		ipc_settings_data.rc = -EINVAL;
+	} else {
+		memcpy(ipc_settings_tree.buffer, message, size);
+		ipc_settings_tree.size = size;
+		ipc_settings_data.rc = 0;
+	}
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_subscribe(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_subscribe_response_data *data = (struct ipc_setting_subscribe_response_data *)message;
+
+	ipc_settings_data.rc = (size < sizeof(struct ipc_setting_subscribe_response_data) ? -EINVAL : data->rc);
+
+	k_sem_give(&ipc_settings_data.done);
+
+	return 0;
+}
+
+static int ipc_setting_callback_boot_load_read_value(void *cb_arg, void *data, size_t len)
+{
+	struct ipc_setting_value *setting = (struct ipc_setting_value *)cb_arg;
+
+	if (len > setting->value_size) {
+		len = setting->value_size;
+	}
+
+	memcpy(data, setting->value, len);
+
+	return len;
+}
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+static uint32_t retained_crc(void)
+{
+	return crc32_ieee((const uint8_t *)&ipc_settings_retained.epoch,
+			  (offsetof(typeof(ipc_settings_retained), buffer) -
+			   offsetof(typeof(ipc_settings_retained), epoch) + ipc_settings_retained.used));
+}
+
+static bool retained_valid(void)
+{
+	return (ipc_settings_retained.magic == IPC_SETTING_RETAINED_MAGIC &&
+		ipc_settings_retained.used <= sizeof(ipc_settings_retained.buffer) &&
+		ipc_settings_retained.crc == retained_crc());
+}
+
+/* Replaces the retained copy of a setting, retained_full is set if it does not fit */
+static void retained_store(const char *name, const uint8_t *value, uint16_t value_size)
+{
+	struct ipc_setting_save_data *record;
+	uint8_t name_size = strlen(name) + 1;
+	uint32_t record_size = sizeof(struct ipc_setting_save_data) + name_size + value_size;
+	uint16_t offset = 0;
+
+	while (offset < ipc_settings_retained.used) {
+		uint16_t size;
+
+		record = (struct ipc_setting_save_data *)&ipc_settings_retained.buffer[offset];
+		size = sizeof(struct ipc_setting_save_data) + record->name_size + record->value_size;
+
+		if (record->name_size == name_size && memcmp(record->setting, name, name_size) == 0) {
+			memmove(&ipc_settings_retained.buffer[offset], &ipc_settings_retained.buffer[(offset + size)],
+				(ipc_settings_retained.used - offset - size));
+			ipc_settings_retained.used -= size;
+			break;
+		}
+
+		offset += size;
+	}
+
+	if (value_size == 0) {
+		/* Deleted setting is not kept */
+		return;
+	}
+
+	if ((ipc_settings_retained.used + record_size) > sizeof(ipc_settings_retained.buffer)) {
+		ipc_settings_boot_sync.retained_full = true;
+		return;
+	}
+
+	record = (struct ipc_setting_save_data *)&ipc_settings_retained.buffer[ipc_settings_retained.used];
+	record->name_size = name_size;
+	record->flags = 0;
+	record->value_size = value_size;
+	memcpy(record->setting, name, name_size);
+	memcpy(&record->setting[name_size], value, value_size);
+	ipc_settings_retained.used += record_size;
+}
+
+/* Loads the retained settings, returns the number of settings */
+static uint16_t retained_replay(void)
+{
+	uint16_t offset = 0;
+	uint16_t count = 0;
+
+	while (offset < ipc_settings_retained.used) {
+		struct ipc_setting_save_data *record = (struct ipc_setting_save_data *)&ipc_settings_retained.buffer[offset];
+		struct ipc_setting_value value = {
+			.value = &record->setting[record->name_size],
+			.value_size = record->value_size,
+		};
+
+		(void)settings_call_set_handler(record->setting, value.value_size,
+						&ipc_setting_callback_boot_load_read_value, &value, NULL);
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+		cache_store(record->setting, value.value, value.value_size);
+#endif
+
+		offset += sizeof(struct ipc_setting_save_data) + record->name_size + record->value_size;
+		++count;
+	}
+
+	return count;
+}
+#endif
+
+/* Loads a boot load record, or adds it to the value being joined if the value is split */
+static void ipc_setting_boot_load_record(const struct ipc_setting_boot_load_data *record, const char *name)
+{
+	int rc;
+	struct ipc_setting_value value = {
+		.value = &record->setting[record->name_size],
+		.value_size = record->value_size,
+	};
+
+	if (ipc_settings_boot_sync.partial || (record->flags & IPC_SETTING_RECORD_FLAG_MORE)) {
+		if (!ipc_settings_boot_sync.partial) {
+			if ((strlen(name) + 1) > sizeof(ipc_settings_boot_sync.name)) {
+				LOG_ERR("Setting %s name too long", name);
+				return;
+			}
+
+			strcpy(ipc_settings_boot_sync.name, name);
+			ipc_settings_boot_sync.value_size = 0;
+			ipc_settings_boot_sync.partial = true;
+		} else if (strcmp(ipc_settings_boot_sync.name, name) != 0) {
+			LOG_ERR("Setting %s incomplete", ipc_settings_boot_sync.name);
+			ipc_settings_boot_sync.partial = false;
+			return;
+		}
+
+		if ((ipc_settings_boot_sync.value_size + record->value_size) > sizeof(ipc_settings_boot_sync.value)) {
+			LOG_ERR("Setting %s too large to load", name);
+			ipc_settings_boot_sync.partial = false;
+			return;
+		}
+
+		memcpy(&ipc_settings_boot_sync.value[ipc_settings_boot_sync.value_size],
+		       value.value, value.value_size);
+		ipc_settings_boot_sync.value_size += record->value_size;
+
+		if (record->flags & IPC_SETTING_RECORD_FLAG_MORE) {
+			return;
+		}
+
+		ipc_settings_boot_sync.partial = false;
+		value.value = ipc_settings_boot_sync.value;
+		value.value_size = ipc_settings_boot_sync.value_size;
+	}
+
+	rc = settings_call_set_handler(name, value.value_size,
+				       &ipc_setting_callback_boot_load_read_value, &value, NULL);
+
+	if (rc != 0) {
+		LOG_ERR("Setting %s not loaded: %d", name, rc);
+	}
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	if (value.value_size == 0) {
+		/* Setting was deleted on the server */
+		cache_invalidate(name);
+	} else {
+		cache_store(name, value.value, value.value_size);
+	}
+#endif
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+	retained_store(name, value.value, value.value_size);
+#endif
+
+	++ipc_settings_boot_sync.records;
+}
+
+static int ipc_setting_callback_boot_load(const uint8_t *message, uint16_t size, void *user_data)
+{
+	int rc;
+	struct ipc_setting_boot_load_frame_data *frame = (struct ipc_setting_boot_load_frame_data *)message;
+	struct ipc_setting_boot_load_ack_data ack;
+	uint16_t offset = sizeof(struct ipc_setting_boot_load_frame_data);
+	uint8_t i;
+
+	if (size < sizeof(struct ipc_setting_boot_load_frame_data)) {
+		return -EINVAL;
+	}
+
+	if (ipc_settings_boot_sync.frames == 0) {
+		ipc_settings_boot_sync.first_frame_ticks = k_uptime_ticks();
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+		if (frame->flags & IPC_SETTING_BOOT_LOAD_FLAG_FULL) {
+			/* Server sends every setting, the retained copy might have deleted ones */
+			ipc_settings_retained.used = 0;
+		} else if (retained_valid()) {
+			/* Settings from before the restart are loaded first, the records which follow
+			 * are what changed
+			 */
+			uint16_t count = retained_replay();
+
+			LOG_INF("Loaded %d retained settings of generation %u", count,
+				ipc_settings_retained.generation);
+		}
+
+		/* Retained settings are not valid until the boot load has finished */
+		ipc_settings_retained.magic = 0;
+		ipc_settings_boot_sync.retained_full = false;
+#endif
+	}
+
+	for (i = 0; i < frame->record_count; ++i) {
+		struct ipc_setting_boot_load_data *setting = (struct ipc_setting_boot_load_data *)&message[offset];
+		const char *name = NULL;
+
+		if ((offset + sizeof(struct ipc_setting_boot_load_data)) <= size &&
+		    (offset + sizeof(struct ipc_setting_boot_load_data) + setting->name_size + setting->value_size) <= size) {
+			name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+		}
+
+		if (name == NULL) {
+			LOG_ERR("Invalid boot load record %d in frame %d", i, frame->seq);
+			break;
+		}
+
+		ipc_setting_boot_load_record(setting, name);
+		offset += sizeof(struct ipc_setting_boot_load_data) + setting->name_size + setting->value_size;
+	}
+
+	++ipc_settings_boot_sync.frames;
+
+	if (frame->flags & IPC_SETTING_BOOT_LOAD_FLAG_END) {
+		int64_t now = k_uptime_ticks();
+
+		LOG_INF("Boot sync complete: %d records in %d frames (%s), %lld us after boot (%lld us transfer)",
+			ipc_settings_boot_sync.records, ipc_settings_boot_sync.frames,
+			((frame->flags & IPC_SETTING_BOOT_LOAD_FLAG_FULL) ? "full" : "changes"),
+			k_ticks_to_us_floor64(now),
+			k_ticks_to_us_floor64(now - ipc_settings_boot_sync.first_frame_ticks));
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+		if (ipc_settings_boot_sync.retained_full) {
+			LOG_WRN("Settings do not fit in retained RAM, next boot sync will be full");
+		} else {
+			ipc_settings_retained.epoch = frame->epoch;
+			ipc_settings_retained.generation = frame->generation;
+			ipc_settings_retained.crc = retained_crc();
+			ipc_settings_retained.magic = IPC_SETTING_RETAINED_MAGIC;
+		}
+#endif
+
+		ipc_settings_boot_sync.records = 0;
+		ipc_settings_boot_sync.frames = 0;
+		k_sem_give(&ipc_settings_boot_sync.done);
+	}
+
+	ack.seq = frame->seq;
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_BOOT_LOAD, sizeof(ack), (uint8_t *)&ack);
+
+	return rc;
+}
+
+static int ipc_setting_callback_invalidate(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_invalidate_data *data = (struct ipc_setting_invalidate_data *)message;
+
+	if (size < sizeof(struct ipc_setting_invalidate_data) ||
+	    size < (sizeof(struct ipc_setting_invalidate_data) + data->name_size) ||
+	    (data->name_size > 0 && data->name[(data->name_size - 1)] != '\0')) {
+		return -EINVAL;
+	}
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	cache_invalidate(data->name_size > 0 ? data->name : NULL);
+#endif
+
+	return 0;
+}
+
+static int ipc_setting_callback_notify(const uint8_t *message, uint16_t size, void *user_data)
+{
+	struct ipc_setting_notify_data *data = (struct ipc_setting_notify_data *)message;
+	uint16_t offset = sizeof(struct ipc_setting_notify_data);
+	uint8_t i;
+
+	if (size < sizeof(struct ipc_setting_notify_data)) {
+		return -EINVAL;
+	}
+
+	(void)k_mutex_lock(&ipc_settings_subscriptions.lock, K_FOREVER);
 
-	return rc;
-}
+	for (i = 0; i < data->record_count; ++i) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&message[offset];
+		struct ipc_setting_subscription *subscription;
+		const char *name = NULL;
 
-#if 0
-static int setting_count_callback(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg, void *param)
-{
-	uint16_t *entries = (uint16_t *)param;
+		if ((offset + sizeof(struct ipc_setting_save_data)) <= size &&
+		    (offset + sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size) <= size) {
+			name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+		}
 
-	++*entries;
-}
+		if (name == NULL) {
+			LOG_ERR("Invalid notification record %d", i);
+			break;
+		}
 
-static int ipc_setting_callback_tree_count(const uint8_t *message, uint16_t size, void *user_data)
-{
-	int rc;
-	uint16_t entries = 0;
-	struct ipc_setting_tree_count_response_data data;
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+		if (setting->value_size > 0) {
+			cache_store(name, &setting->setting[setting->name_size], setting->value_size);
+		}
+#endif
 
-	rc = settings_load_subtree_direct(NULL, setting_count_callback, &entries);
+		SYS_SLIST_FOR_EACH_CONTAINER(&ipc_settings_subscriptions.list, subscription, node) {
+			if (subscription->prefix == NULL || settings_name_steq(name, subscription->prefix, NULL)) {
+				(void)subscription->cb(name, &setting->setting[setting->name_size],
+						       setting->value_size, subscription->user_data);
+			}
+		}
 
-	if (rc < 0) {
-		return rc;
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
 	}
 
-LOG_ERR("stgs: %d", entries);
-
-	data.count = entries;
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_COUNT, sizeof(data), (uint8_t *)&data);
+	k_mutex_unlock(&ipc_settings_subscriptions.lock);
 
-	return rc;
+	return 0;
 }
 
-static int ipc_setting_callback_tree_load(const uint8_t *message, uint16_t size, void *user_data)
+int ipc_setting_boot_sync(uint8_t *key)
 {
 	int rc;
-	struct ipc_setting_tree_load_data *setting = (struct ipc_setting_tree_load_data *)message;
-	struct ipc_setting_tree_load_response_data *data;
-
-#if 0
-	rc = settings_runtime_get(setting->name, data->setting, setting->max_value_size);
-
-LOG_ERR("def: %d for %s", rc, setting->name);
-data->rc = rc;
+	struct ipc_setting_boot_sync_data *data;
+	uint8_t key_size = strlen(key) + 1;
+	uint32_t epoch = 0;
+	uint32_t generation = 0;
+
+	k_sem_reset(&ipc_settings_boot_sync.done);
+
+#if defined(CONFIG_IPC_SETTINGS_WARM_SYNC)
+	if (retained_valid()) {
+		/* Server replies with the changes since this generation if it still knows them,
+		 * otherwise with every setting, the retained settings are only loaded for the former
+		 */
+		epoch = ipc_settings_retained.epoch;
+		generation = ipc_settings_retained.generation;
+	} else {
+		ipc_settings_retained.magic = 0;
+		ipc_settings_retained.used = 0;
+	}
 #endif
 
-	data->value_size = (rc >= 0 ? rc : 0);
+	data = (struct ipc_setting_boot_sync_data *)ipc_get_buffer();
+	data->epoch = epoch;
+	data->generation = generation;
+	data->key_size = key_size;
+	memcpy(data->key, key, key_size);
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_LOAD, 16, (uint8_t *)data);
-	free(data);
+	rc = ipc_send_buffer(IPC_OPCODE_SETTINGS_BOOT_SYNC, (sizeof(struct ipc_setting_boot_sync_data) + key_size));
 
-	return rc;
+	if (rc < 0) {
+		return rc;
+	}
+
+	return k_sem_take(&ipc_settings_boot_sync.done, IPC_SETTING_BOOT_SYNC_TIMEOUT);
 }
-#endif
 
-static int ipc_setting_callback_boot_load(const uint8_t *message, uint16_t size, void *user_data)
+static void ipc_setting_batch_reset(void)
 {
-	k_sem_give(&ipc_settings_data.done);
-	return 0;
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)ipc_settings_batch.buffer;
+
+	data->flags = 0;
+	data->record_count = 0;
+	ipc_settings_batch.used = sizeof(struct ipc_setting_save_batch_data);
 }
 
-static int ipc_setting_boot_load_loop(const char *name, size_t value_size, settings_read_cb read_cb, void *cb_arg, void *param)
+static int ipc_setting_batch_send(uint8_t flags)
 {
 	int rc;
-	struct ipc_setting_boot_load_data *data;
-	uint8_t *key = (uint8_t *)param;
-	uint8_t key_size = strlen(key) + 1;
-	uint8_t part_size = strlen(name) + 1;
-	uint8_t name_size = key_size + part_size;
-	uint16_t total_size = sizeof(struct ipc_setting_boot_load_data) + name_size + value_size;
-
-	data = (struct ipc_setting_boot_load_data *)malloc(total_size);
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)ipc_settings_batch.buffer;
 
-	data->name_size = name_size;
-	data->value_size = value_size;
-	memcpy(data->setting, key, key_size);
-	data->setting[(key_size - 1)] = '/';
-	memcpy(&data->setting[key_size], name, part_size);
-	(void)read_cb(cb_arg, &data->setting[name_size], value_size);
+	data->flags = flags;
 
-LOG_ERR("setting: %s length: %d", name, value_size);
-
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_BOOT_LOAD, total_size, (uint8_t *)data);
-	free(data);
+	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
+	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SAVE_BATCH, ipc_settings_batch.used, ipc_settings_batch.buffer);
 
-//check length?
 	if (rc < 0) {
 		goto finish;
 	}
 
 	rc = k_sem_take(&ipc_settings_data.done, K_FOREVER);
 
+	if (rc == 0) {
+		rc = ipc_settings_data.rc;
+	}
+
 finish:
+	k_sem_give(&ipc_settings_data.busy);
+	ipc_setting_batch_reset();
+	ipc_settings_batch.staged = true;
+
 	return rc;
 }
 
-int ipc_setting_boot_load(uint8_t *key)
+static int ipc_setting_batch_add(uint8_t *name, uint8_t *value, uint16_t value_size)
 {
 	int rc;
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)ipc_settings_batch.buffer;
+	struct ipc_setting_save_data *record;
+	uint16_t id;
+	uint8_t name_size = ipc_setting_record_name_size(name, &id);
+	uint16_t header_size = sizeof(struct ipc_setting_save_data) + name_size;
+	uint16_t offset = 0;
+
+	if ((header_size + MIN(value_size, IPC_SETTING_MIN_CHUNK_SIZE)) >
+	    (sizeof(ipc_settings_batch.buffer) - sizeof(struct ipc_setting_save_batch_data))) {
+		return -EMSGSIZE;
+	}
 
-	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
-	rc = settings_load_subtree_direct(key, ipc_setting_boot_load_loop, key);
-	k_sem_give(&ipc_settings_data.busy);
-	return rc;
-}
+	/* Values which do not fit in the rest of the frame are split into records flagged with
+	 * IPC_SETTING_RECORD_FLAG_MORE, which the server joins back together
+	 */
+	while (1) {
+		uint16_t space = sizeof(ipc_settings_batch.buffer) - ipc_settings_batch.used;
+		uint16_t chunk = value_size - offset;
 
-#endif
+		if (space < (header_size + MIN(chunk, IPC_SETTING_MIN_CHUNK_SIZE))) {
+			/* Frame is full, have the server stage what has been collected so far */
+			rc = ipc_setting_batch_send(0);
 
-#if defined(CONFIG_IPC_SETTINGS_CLIENT)
-static int ipc_setting_callback_save(const uint8_t *message, uint16_t size, void *user_data)
-{
-//get error, give sem
-	struct ipc_setting_save_response_data *data = (struct ipc_setting_save_response_data *)message;
+			if (rc != 0) {
+				return rc;
+			}
 
-	ipc_settings_data.rc = data->rc;
-LOG_ERR("abc: %d", data->rc);
+			continue;
+		}
 
-	k_sem_give(&ipc_settings_data.done);
+		if (chunk > (space - header_size)) {
+			chunk = space - header_size;
+		}
 
-	return 0;
-}
+		record = (struct ipc_setting_save_data *)&ipc_settings_batch.buffer[ipc_settings_batch.used];
+		record->name_size = name_size;
+		record->flags = ipc_setting_record_name_put(record->setting, name, id, name_size) |
+				((offset + chunk) < value_size ? IPC_SETTING_RECORD_FLAG_MORE : 0);
+		record->value_size = chunk;
+		memcpy((record->setting + name_size), &value[offset], chunk);
 
-static int ipc_setting_callback_load(const uint8_t *message, uint16_t size, void *user_data)
-{
-	struct ipc_setting_load_response_data *data = (struct ipc_setting_load_response_data *)message;
-	ipc_settings_data.rc = data->rc;
+		ipc_settings_batch.used += header_size + chunk;
+		++data->record_count;
+		offset += chunk;
 
-//do null check on ipc_settings_data.load_pointer ? do size check on ipc_settings_data.load_size ?
+		if (offset >= value_size) {
+			break;
+		}
+	}
 
-LOG_HEXDUMP_ERR(data->setting, data->rc, "teh");
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	cache_store(name, value, value_size);
+#endif
 
-	memcpy(ipc_settings_data.load_pointer, data->setting, data->value_size);
+	return 0;
+}
 
-	ipc_settings_data.load_pointer = NULL;
-	ipc_settings_data.load_size = 0;
-LOG_ERR("def: %d", data->rc);
+int ipc_setting_batch_begin(void)
+{
+	(void)k_mutex_lock(&ipc_settings_batch.lock, K_FOREVER);
+
+	if (ipc_settings_batch.depth == 0) {
+		ipc_settings_batch.commit = false;
+		ipc_settings_batch.staged = false;
+		ipc_settings_batch.aborted = false;
+		ipc_settings_batch.rc = 0;
+		ipc_setting_batch_reset();
+	}
 
-	k_sem_give(&ipc_settings_data.done);
+	++ipc_settings_batch.depth;
 
 	return 0;
 }
 
-static int ipc_setting_callback_commit(const uint8_t *message, uint16_t size, void *user_data)
+/* Ends a level of the session, the session is sent to the server when the outermost level ends.
+ * A session which had an error or was aborted at any level is discarded
+ */
+static int ipc_setting_batch_finish(bool commit, bool abort)
 {
-	struct ipc_setting_commit_response_data *data = (struct ipc_setting_commit_response_data *)message;
+	int rc = 0;
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)ipc_settings_batch.buffer;
 
-	ipc_settings_data.rc = data->rc;
-LOG_ERR("qui: %d", data->rc);
+	if (ipc_settings_batch.depth == 0) {
+		return -EINVAL;
+	}
 
-	k_sem_give(&ipc_settings_data.done);
+	ipc_settings_batch.commit |= commit;
+	ipc_settings_batch.aborted |= abort;
+	--ipc_settings_batch.depth;
 
-	return 0;
-}
+	if (ipc_settings_batch.depth > 0) {
+		goto finish;
+	}
 
-#if 0
-static int ipc_setting_callback_tree_count(const uint8_t *message, uint16_t size, void *user_data)
-{
-	struct ipc_setting_tree_count_response_data *data = (struct ipc_setting_tree_count_response_data *)message;
+	if (ipc_settings_batch.aborted || ipc_settings_batch.rc != 0) {
+		if (ipc_settings_batch.staged) {
+			/* Server drops the frames it already staged */
+			rc = ipc_setting_batch_send(IPC_SETTING_BATCH_FLAG_ABORT);
+		}
 
-	ipc_settings_data.rc = data->count;
-LOG_ERR("qui: %d", data->count);
+		if (!abort) {
+			rc = (ipc_settings_batch.rc != 0 ? ipc_settings_batch.rc : -ECANCELED);
+		}
 
-	k_sem_give(&ipc_settings_data.done);
+		ipc_setting_batch_reset();
 
-	return 0;
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+		/* Values of the session were cached when they were added */
+		cache_invalidate(NULL);
+#endif
+	} else if (data->record_count > 0 || ipc_settings_batch.staged || ipc_settings_batch.commit) {
+		rc = ipc_setting_batch_send(IPC_SETTING_BATCH_FLAG_APPLY |
+					    (ipc_settings_batch.commit ? IPC_SETTING_BATCH_FLAG_COMMIT : 0));
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+		if (rc != 0) {
+			/* Cached values of the session might not have been stored */
+			cache_invalidate(NULL);
+		}
+#endif
+	}
+
+finish:
+	k_mutex_unlock(&ipc_settings_batch.lock);
+
+	return rc;
 }
 
-static int ipc_setting_callback_tree_load(const uint8_t *message, uint16_t size, void *user_data)
+int ipc_setting_batch_end(bool commit)
 {
+	return ipc_setting_batch_finish(commit, false);
 }
-#endif
 
-static int ipc_setting_callback_boot_load_read_value(void *cb_arg, void *data, size_t len)
+int ipc_setting_batch_abort(void)
 {
-	struct ipc_setting_boot_load_data *setting = (struct ipc_setting_boot_load_data *)cb_arg;
-
-	if (len > setting->value_size) {
-		len = setting->value_size;
-	}
-
-	memcpy(data, &setting->setting[setting->name_size], len);
-
-	return len;
+	return ipc_setting_batch_finish(false, true);
 }
 
-static int ipc_setting_callback_boot_load(const uint8_t *message, uint16_t size, void *user_data)
+int ipc_setting_save(uint8_t *name, uint8_t *value, uint16_t value_size)
 {
 	int rc;
-	struct ipc_setting_boot_load_data *setting = (struct ipc_setting_boot_load_data *)message;
+	struct ipc_setting_save_data *data;
+	uint16_t id;
+	uint8_t name_size = ipc_setting_record_name_size(name, &id);
+	uint32_t total_size = sizeof(struct ipc_setting_save_data) + name_size + value_size;
 
-LOG_ERR("got %d length value for %s", setting->value_size, setting->setting);
+	if (total_size > IPC_MESSAGE_DATA_SIZE) {
+		/* Too large for a single message, send it as a save session which splits the value */
+		(void)ipc_setting_batch_begin();
+		(void)ipc_setting_save(name, value, value_size);
 
-	rc = settings_call_set_handler(setting->setting, setting->value_size,
-				       &ipc_setting_callback_boot_load_read_value, setting, NULL);
+		return ipc_setting_batch_end(false);
+	}
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_BOOT_LOAD, 0, NULL);
+	(void)k_mutex_lock(&ipc_settings_batch.lock, K_FOREVER);
 
-	return rc;
-}
+	if (ipc_settings_batch.depth > 0) {
+		/* Part of a save session, sent when the session ends or the frame is full */
+		rc = ipc_setting_batch_add(name, value, value_size);
 
-int ipc_setting_save(uint8_t *name, uint8_t *value, uint8_t value_size)
-{
-	int rc;
-	struct ipc_setting_save_data *data;
-	uint8_t name_size = strlen(name) + 1;
-	uint16_t total_size = sizeof(struct ipc_setting_save_data) + name_size + value_size;
+		if (rc != 0 && ipc_settings_batch.rc == 0) {
+			ipc_settings_batch.rc = rc;
+		}
+
+		k_mutex_unlock(&ipc_settings_batch.lock);
+
+		return rc;
+	}
+
+	k_mutex_unlock(&ipc_settings_batch.lock);
 
 	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
 
-	data = (struct ipc_setting_save_data *)malloc(total_size);
+	data = (struct ipc_setting_save_data *)ipc_get_buffer();
 	data->name_size = name_size;
+	data->flags = ipc_setting_record_name_put(data->setting, name, id, name_size);
 	data->value_size = value_size;
-	memcpy(data->setting, name, name_size);
 	memcpy((data->setting + name_size), value, value_size);
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_SAVE, total_size, (uint8_t *)data);
-	free(data);
+	rc = ipc_send_buffer(IPC_OPCODE_SETTINGS_SAVE, total_size);
 
-//check length?
 	if (rc < 0) {
 		goto finish;
 	}
@@ -444,29 +3306,48 @@ int ipc_setting_save(uint8_t *name, uint8_t *value, uint8_t value_size)
 
 finish:
 	k_sem_give(&ipc_settings_data.busy);
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	if (rc == 0) {
+		cache_store(name, value, value_size);
+	} else {
+		cache_invalidate(name);
+	}
+#endif
+
 	return rc;
 }
 
-int ipc_setting_load(uint8_t *name, uint8_t *value, uint8_t max_value_size)
+int ipc_setting_load(uint8_t *name, uint8_t *value, uint16_t max_value_size)
 {
 	int rc;
 	struct ipc_setting_load_data *data;
 	uint8_t name_size = strlen(name) + 1;
 	uint16_t total_size = sizeof(struct ipc_setting_load_data) + name_size;
 
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	rc = cache_load(name, value, max_value_size);
+
+	if (rc != -ENOENT) {
+		return rc;
+	}
+#endif
+
+	/* Values larger than fit in a single response fail with -E2BIG */
+	max_value_size = MIN(max_value_size, IPC_SETTING_LOAD_MAX_VALUE_SIZE);
+
 	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
 
-	data = (struct ipc_setting_load_data *)malloc(total_size);
+	ipc_settings_data.load_pointer = value;
+	ipc_settings_data.load_size = max_value_size;
+
+	data = (struct ipc_setting_load_data *)ipc_get_buffer();
 	data->name_size = name_size;
 	data->max_value_size = max_value_size;
 	memcpy(data->name, name, name_size);
-	ipc_settings_data.load_pointer = value;
-	ipc_settings_data.load_size = max_value_size;
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_LOAD, total_size, (uint8_t *)data);
-	free(data);
+	rc = ipc_send_buffer(IPC_OPCODE_SETTINGS_LOAD, total_size);
 
-//check length?
 	if (rc < 0) {
 		goto finish;
 	}
@@ -479,6 +3360,13 @@ int ipc_setting_load(uint8_t *name, uint8_t *value, uint8_t max_value_size)
 
 finish:
 	k_sem_give(&ipc_settings_data.busy);
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	if (rc >= 0) {
+		cache_store(name, value, rc);
+	}
+#endif
+
 	return rc;
 }
 
@@ -505,31 +3393,47 @@ finish:
 	return rc;
 }
 
-#if 0
-int ipc_setting_tree_count(uint16_t *count)
+/* Sends a tree request with an optional prefix and waits for the response */
+static int ipc_setting_tree_request(uint8_t opcode, uint8_t *prefix, uint16_t cursor)
 {
 	int rc;
+	uint8_t *data;
+	uint8_t prefix_size = (prefix != NULL ? (strlen(prefix) + 1) : 0);
+	uint16_t header_size = (opcode == IPC_OPCODE_SETTINGS_TREE_LOAD ?
+				sizeof(struct ipc_setting_tree_load_data) :
+				sizeof(struct ipc_setting_tree_count_data));
+	uint16_t total_size = header_size + prefix_size;
 
 	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_COUNT, 0, NULL);
 
-//check length?
-LOG_ERR("uu1 %d", rc);
+	data = (uint8_t *)malloc(total_size);
+
+	if (opcode == IPC_OPCODE_SETTINGS_TREE_LOAD) {
+		struct ipc_setting_tree_load_data *request = (struct ipc_setting_tree_load_data *)data;
+
+		request->cursor = cursor;
+		request->prefix_size = prefix_size;
+	} else {
+		struct ipc_setting_tree_count_data *request = (struct ipc_setting_tree_count_data *)data;
+
+		request->prefix_size = prefix_size;
+	}
+
+	if (prefix_size > 0) {
+		memcpy(&data[header_size], prefix, prefix_size);
+	}
+
+	rc = ipc_send_message(opcode, total_size, data);
+	free(data);
+
 	if (rc < 0) {
 		goto finish;
 	}
 
 	rc = k_sem_take(&ipc_settings_data.done, K_FOREVER);
 
-LOG_ERR("uu2 %d", rc);
 	if (rc == 0) {
-		if (ipc_settings_data.rc < 0) {
-			rc = ipc_settings_data.rc;
-LOG_ERR("uu3 %d", rc);
-		} else {
-			*count = ipc_settings_data.rc;
-LOG_ERR("uu4 %d", *count);
-		}
+		rc = ipc_settings_data.rc;
 	}
 
 finish:
@@ -537,32 +3441,120 @@ finish:
 	return rc;
 }
 
-int ipc_setting_tree_load(uint16_t index, uint8_t *name, uint8_t *value, uint8_t *value_size)
+int ipc_setting_tree_count(uint8_t *prefix, uint16_t *count)
 {
 	int rc;
-	struct ipc_setting_tree_load_data data;
-	struct ipc_setting_tree_load_response_data response_data = {
-		.name = name,
-		.value = value,
-		.value_size = value_size,
-	};
 
-#if 0
-	uint8_t *name;
-	uint8_t *value;
-	uint8_t *value_size;
+	(void)k_mutex_lock(&ipc_settings_tree.lock, K_FOREVER);
+	rc = ipc_setting_tree_request(IPC_OPCODE_SETTINGS_TREE_COUNT, prefix, 0);
+
+	if (rc == 0) {
+		*count = ipc_settings_tree.count;
+	}
+
+	k_mutex_unlock(&ipc_settings_tree.lock);
+
+	return rc;
+}
+
+int ipc_setting_tree_load(uint8_t *prefix, uint16_t *cursor, ipc_setting_tree_cb cb, void *user_data)
+{
+	int rc;
+	struct ipc_setting_tree_load_response_data *response = (struct ipc_setting_tree_load_response_data *)ipc_settings_tree.buffer;
+	uint16_t offset = sizeof(struct ipc_setting_tree_load_response_data);
+	uint8_t i;
+
+	if (*cursor == IPC_SETTING_TREE_CURSOR_END) {
+		return 0;
+	}
+
+	(void)k_mutex_lock(&ipc_settings_tree.lock, K_FOREVER);
+	rc = ipc_setting_tree_request(IPC_OPCODE_SETTINGS_TREE_LOAD, prefix, *cursor);
+
+	if (rc == 0) {
+		rc = response->rc;
+	}
+
+	if (rc < 0) {
+		goto finish;
+	}
+
+	for (i = 0; i < response->record_count; ++i) {
+		struct ipc_setting_save_data *setting = (struct ipc_setting_save_data *)&ipc_settings_tree.buffer[offset];
+		const char *name = NULL;
+
+		if ((offset + sizeof(struct ipc_setting_save_data)) <= ipc_settings_tree.size &&
+		    (offset + sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size) <= ipc_settings_tree.size) {
+			name = ipc_setting_record_name(setting->setting, setting->name_size, setting->flags);
+		}
+
+		if (name == NULL) {
+			rc = -EINVAL;
+			goto finish;
+		}
+
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+		cache_store(name, &setting->setting[setting->name_size], setting->value_size);
 #endif
 
-	data.index = index;
+		if (cb != NULL) {
+			rc = cb(name, &setting->setting[setting->name_size], setting->value_size, user_data);
+
+			if (rc != 0) {
+				goto finish;
+			}
+		}
+
+		offset += sizeof(struct ipc_setting_save_data) + setting->name_size + setting->value_size;
+	}
+
+	*cursor = ((response->flags & IPC_SETTING_TREE_FLAG_END) ? IPC_SETTING_TREE_CURSOR_END : response->next_cursor);
+	rc = response->record_count;
+
+finish:
+	k_mutex_unlock(&ipc_settings_tree.lock);
+
+	return rc;
+}
+
+int ipc_setting_tree_load_all(uint8_t *prefix, ipc_setting_tree_cb cb, void *user_data)
+{
+	int rc;
+	int total = 0;
+	uint16_t cursor = 0;
+
+	while (cursor != IPC_SETTING_TREE_CURSOR_END) {
+		rc = ipc_setting_tree_load(prefix, &cursor, cb, user_data);
+
+		if (rc < 0) {
+			return rc;
+		}
+
+		total += rc;
+	}
+
+	return total;
+}
+
+/* Adds or removes a subscription to prefix on the server */
+static int ipc_setting_subscribe_request(const uint8_t *prefix, uint8_t flags)
+{
+	int rc;
+	struct ipc_setting_subscribe_data *data;
+	uint8_t prefix_size = (prefix != NULL ? (strlen(prefix) + 1) : 0);
 
 	rc = k_sem_take(&ipc_settings_data.busy, K_FOREVER);
 
-	ipc_settings_data.load_pointer = &response_data;
+	data = (struct ipc_setting_subscribe_data *)ipc_get_buffer();
+	data->flags = flags;
+	data->prefix_size = prefix_size;
+
+	if (prefix_size > 0) {
+		memcpy(data->prefix, prefix, prefix_size);
+	}
 
-	rc = ipc_send_message(IPC_OPCODE_SETTINGS_TREE_LOAD, sizeof(data), (uint8_t *)&data);
-//	free(data);
+	rc = ipc_send_buffer(IPC_OPCODE_SETTINGS_SUBSCRIBE, (sizeof(struct ipc_setting_subscribe_data) + prefix_size));
 
-//check length?
 	if (rc < 0) {
 		goto finish;
 	}
@@ -574,36 +3566,99 @@ int ipc_setting_tree_load(uint16_t index, uint8_t *name, uint8_t *value, uint8_t
 	}
 
 finish:
-#if 0
-	if (response_data != NULL) {
-		free(response_data);
-		response_data = NULL;
+	k_sem_give(&ipc_settings_data.busy);
+	return rc;
+}
+
+int ipc_setting_subscribe(struct ipc_setting_subscription *subscription)
+{
+	int rc;
+
+	if (subscription->cb == NULL) {
+		return -EINVAL;
+	}
+
+	/* Added first so that a notification sent before the response is not missed */
+	(void)k_mutex_lock(&ipc_settings_subscriptions.lock, K_FOREVER);
+	sys_slist_append(&ipc_settings_subscriptions.list, &subscription->node);
+	k_mutex_unlock(&ipc_settings_subscriptions.lock);
+
+	rc = ipc_setting_subscribe_request(subscription->prefix, 0);
+
+	if (rc != 0) {
+		(void)k_mutex_lock(&ipc_settings_subscriptions.lock, K_FOREVER);
+		(void)sys_slist_find_and_remove(&ipc_settings_subscriptions.list, &subscription->node);
+		k_mutex_unlock(&ipc_settings_subscriptions.lock);
 	}
-#endif
 
-	k_sem_give(&ipc_settings_data.busy);
 	return rc;
 }
-#endif
+
+int ipc_setting_unsubscribe(struct ipc_setting_subscription *subscription)
+{
+	bool found;
+
+	(void)k_mutex_lock(&ipc_settings_subscriptions.lock, K_FOREVER);
+	found = sys_slist_find_and_remove(&ipc_settings_subscriptions.list, &subscription->node);
+	k_mutex_unlock(&ipc_settings_subscriptions.lock);
+
+	if (!found) {
+		return -ENOENT;
+	}
+
+	return ipc_setting_subscribe_request(subscription->prefix, IPC_SETTING_SUBSCRIBE_FLAG_REMOVE);
+}
 #endif
 
 static int ipc_settings_register(void)
 {
+	ipc_setting_id_sort();
 	k_sem_init(&ipc_settings_data.busy, 1, 1);
 	k_sem_init(&ipc_settings_data.done, 0, 1);
 #if defined(CONFIG_IPC_SETTINGS_CLIENT)
 	ipc_settings_data.load_pointer = NULL;
 	ipc_settings_data.load_size = 0;
+	k_mutex_init(&ipc_settings_batch.lock);
+	k_mutex_init(&ipc_settings_tree.lock);
+	k_sem_init(&ipc_settings_boot_sync.done, 0, 1);
+	k_mutex_init(&ipc_settings_subscriptions.lock);
+	sys_slist_init(&ipc_settings_subscriptions.list);
+#endif
+#if defined(CONFIG_IPC_SETTINGS_CACHE)
+	k_mutex_init(&ipc_settings_cache.lock);
+#endif
+#if defined(CONFIG_IPC_SETTINGS_SERVER)
+	k_sem_init(&ipc_settings_boot_load.credits, CONFIG_IPC_SETTINGS_BOOT_LOAD_WINDOW,
+		   CONFIG_IPC_SETTINGS_BOOT_LOAD_WINDOW);
+	k_mutex_init(&ipc_settings_notify.lock);
+	k_work_queue_init(&ipc_settings_boot_sync_work_q);
+	k_work_queue_start(&ipc_settings_boot_sync_work_q, ipc_settings_boot_sync_stack,
+			   K_THREAD_STACK_SIZEOF(ipc_settings_boot_sync_stack),
+			   CONFIG_IPC_SETTINGS_BOOT_SYNC_THREAD_PRIORITY,
+			   &ipc_settings_boot_sync_work_q_config);
+#endif
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	k_mutex_init(&ipc_settings_index.lock);
+	LOG_INF("Settings index: %d entries, %d byte arena, %d bytes of RAM",
+		CONFIG_IPC_SETTINGS_INDEX_ENTRIES, CONFIG_IPC_SETTINGS_INDEX_SIZE,
+		(int)sizeof(ipc_settings_index));
 #endif
 
 	ipc_register(&ipc_group_save);
 	ipc_register(&ipc_group_load);
 	ipc_register(&ipc_group_commit);
-#if 0
+	ipc_register(&ipc_group_save_batch);
 	ipc_register(&ipc_group_tree_count);
 	ipc_register(&ipc_group_tree_load);
-#endif
+	ipc_register(&ipc_group_subscribe);
 	ipc_register(&ipc_group_boot_load);
+#if defined(CONFIG_IPC_SETTINGS_CLIENT)
+	ipc_register(&ipc_group_invalidate);
+	ipc_register(&ipc_group_notify);
+#endif
+#if defined(CONFIG_IPC_SETTINGS_SERVER)
+	ipc_register(&ipc_group_boot_sync);
+#endif
 
 	return 0;
 }
@@ -5,9 +5,123 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/sys/slist.h>
 
-int ipc_setting_save(uint8_t *name, uint8_t *value, uint8_t value_size);
-int ipc_setting_load(uint8_t *name, uint8_t *value, uint8_t max_value_size);
+/* Cursor returned by ipc_setting_tree_load() once all settings have been loaded */
+#define IPC_SETTING_TREE_CURSOR_END 0xffff
+
+/** Called for each setting loaded by ipc_setting_tree_load(), a non-zero return stops loading */
+typedef int (*ipc_setting_tree_cb)(const uint8_t *name, const uint8_t *value, uint16_t value_size,
+				   void *user_data);
+
+/** Subscription to changes of the settings under prefix (all if NULL) made on the server, cb is
+ * called with the new value (empty if the setting was deleted) from the IPC thread so must not
+ * block or call the IPC settings functions
+ */
+struct ipc_setting_subscription {
+	sys_snode_t node;
+	const uint8_t *prefix;
+	ipc_setting_tree_cb cb;
+	void *user_data;
+};
+
+struct ipc_setting_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t invalidations;
+	/* Number of cached settings and bytes of the cache in use */
+	uint16_t entries;
+	uint16_t used;
+};
+
+/* Bucket n of the save latency histogram counts saves which took less than 2^(n + 6) us, the
+ * last bucket counts all longer saves
+ */
+#define IPC_SETTING_SAVE_LATENCY_BUCKETS 12
+
+struct ipc_setting_save_stats {
+	uint32_t latency[IPC_SETTING_SAVE_LATENCY_BUCKETS];
+	uint32_t max_us;
+	/* Garbage collections done while idle, the longest of them and the free space of the
+	 * active storage sector when it was last checked
+	 */
+	uint32_t gc_runs;
+	uint32_t gc_max_us;
+	int32_t free_space;
+};
+
+struct ipc_setting_index_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	/* Number of indexed settings, bytes of the arena in use and total RAM used by the index */
+	uint16_t entries;
+	uint16_t used;
+	uint32_t ram_size;
+};
+
+int ipc_setting_save(uint8_t *name, uint8_t *value, uint16_t value_size);
+int ipc_setting_load(uint8_t *name, uint8_t *value, uint16_t max_value_size);
 int ipc_setting_commit(void);
-int ipc_setting_tree_count(uint16_t *count);
 int ipc_setting_boot_load(uint8_t *key);
+
+/** Request the settings under key from the server at client start and wait until they have been
+ * loaded. If the server only sends the settings which changed since before a restart (including
+ * deleted ones, with no value), the retained settings are loaded first; otherwise all settings
+ * are sent
+ */
+int ipc_setting_boot_sync(uint8_t *key);
+
+/** Serve boot sync requests from the client, must be called once settings have been loaded. From
+ * then on settings saved or deleted on the application core (with settings_save_one() or
+ * settings_delete()) are dropped from the client's cache and sent to its subscriptions
+ */
+void ipc_setting_server_ready(void);
+
+/** Start a save session, saves until the matching ipc_setting_batch_end() are sent to the server
+ * together and written as one transaction. Sessions can be nested
+ */
+int ipc_setting_batch_begin(void);
+
+/** End a save session level, the session is written when the outermost level ends. Returns
+ * -ECANCELED if it was aborted, nothing of a session which failed or was aborted is written
+ */
+int ipc_setting_batch_end(bool commit);
+
+/** End a save session level and discard the whole session */
+int ipc_setting_batch_abort(void);
+
+/** Subscribe to changes made on the server, changes within CONFIG_IPC_SETTINGS_NOTIFY_DELAY of
+ * each other are sent in one notification. Settings too large for a notification are only
+ * invalidated in the cache. Subscriptions are dropped by the server when the client boot syncs
+ */
+int ipc_setting_subscribe(struct ipc_setting_subscription *subscription);
+
+/** Remove a subscription added with ipc_setting_subscribe() */
+int ipc_setting_unsubscribe(struct ipc_setting_subscription *subscription);
+
+/** Get server settings save latency and garbage collection statistics */
+int ipc_setting_save_stats_get(struct ipc_setting_save_stats *stats);
+
+/** Get server settings index statistics */
+int ipc_setting_index_stats_get(struct ipc_setting_index_stats *stats);
+
+/** Get client settings cache statistics */
+int ipc_setting_cache_stats_get(struct ipc_setting_cache_stats *stats);
+
+/** Remove all settings from the client settings cache */
+void ipc_setting_cache_clear(void);
+
+/** Count the settings under prefix, or all settings if prefix is NULL */
+int ipc_setting_tree_count(uint8_t *prefix, uint16_t *count);
+
+/** Load a page of settings under prefix (all if NULL) starting at cursor (0 for the first page),
+ * cursor is updated to the start of the next page or IPC_SETTING_TREE_CURSOR_END. Returns the
+ * number of settings in the page. cb must not call the tree functions
+ */
+int ipc_setting_tree_load(uint8_t *prefix, uint16_t *cursor, ipc_setting_tree_cb cb, void *user_data);
+
+/** Load all settings under prefix (all if NULL) page by page, returns the number of settings */
+int ipc_setting_tree_load_all(uint8_t *prefix, ipc_setting_tree_cb cb, void *user_data);
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * Messages exchanged between the IPC settings client and server, shared by both sides and by the
+ * benchmarks which build messages themselves.
+ */
+
+#ifndef APP_IPC_SETTINGS_PROTOCOL_H
+#define APP_IPC_SETTINGS_PROTOCOL_H
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/util.h>
+#include "ipc_endpoint.h"
+
+/* Value continues in the next record, which has the same name. Values which do not fit in a
+ * single frame are sent as a sequence of records
+ */
+#define IPC_SETTING_RECORD_FLAG_MORE BIT(0)
+
+/* Name is the 16-bit little endian ID of a setting in IPC_SETTING_ID_LIST instead of a string */
+#define IPC_SETTING_RECORD_FLAG_ID BIT(1)
+
+/* Records are packed back to back in frames so have no alignment */
+struct ipc_setting_save_data {
+	uint8_t name_size;
+	uint8_t flags;
+	uint16_t value_size;
+	uint8_t setting[]; //Name (or ID), followed by value
+} __packed;
+
+/* Smallest part of a value which is put in a record at the end of a frame, instead of starting
+ * the record in the next frame
+ */
+#define IPC_SETTING_MIN_CHUNK_SIZE 32
+
+struct ipc_setting_save_response_data {
+	int rc;
+};
+
+/* Apply: write the session's keys, commit: session came from a full settings save. Both only
+ * write keys whose value changed
+ */
+#define IPC_SETTING_BATCH_FLAG_APPLY BIT(0)
+#define IPC_SETTING_BATCH_FLAG_COMMIT BIT(1)
+/* Discard the session's staged keys without writing any of them */
+#define IPC_SETTING_BATCH_FLAG_ABORT BIT(2)
+
+struct ipc_setting_save_batch_data {
+	uint8_t flags;
+	uint8_t record_count;
+	uint8_t records[]; //Records in ipc_setting_save_data format, back to back
+};
+
+struct ipc_setting_save_batch_response_data {
+	int rc;
+};
+
+struct ipc_setting_load_data {
+	uint8_t name_size;
+	uint16_t max_value_size;
+	uint8_t name[];
+} __packed;
+
+struct ipc_setting_load_response_data {
+	int rc;
+	uint16_t value_size;
+	uint8_t setting[];
+} __packed;
+
+/* Largest value which fits in a load response */
+#define IPC_SETTING_LOAD_MAX_VALUE_SIZE (IPC_MESSAGE_DATA_SIZE - sizeof(struct ipc_setting_load_response_data))
+
+struct ipc_setting_commit_response_data {
+	int rc;
+};
+
+struct ipc_setting_tree_count_data {
+	uint8_t prefix_size; //0 for all settings
+	uint8_t prefix[];
+};
+
+struct ipc_setting_tree_count_response_data {
+	int rc;
+	uint16_t count;
+};
+
+struct ipc_setting_tree_load_data {
+	uint16_t cursor;
+	uint8_t prefix_size; //0 for all settings
+	uint8_t prefix[];
+};
+
+#define IPC_SETTING_TREE_FLAG_END BIT(0)
+
+struct ipc_setting_tree_load_response_data {
+	int rc;
+	uint16_t next_cursor;
+	uint8_t flags;
+	uint8_t record_count;
+	uint8_t records[]; //Records in ipc_setting_save_data format, back to back
+};
+
+struct ipc_setting_boot_load_data {
+	uint8_t name_size;
+	uint8_t flags;
+	uint16_t value_size;
+	uint8_t setting[]; //Name (or ID), followed by value
+} __packed;
+
+#define IPC_SETTING_BOOT_LOAD_FLAG_END BIT(0)
+/* Boot load has all settings of the key, not only those which changed since the generation the
+ * client asked for
+ */
+#define IPC_SETTING_BOOT_LOAD_FLAG_FULL BIT(1)
+
+/* Epoch identifies the server boot which generation numbers belong to, generation is the latest
+ * change which the client has once the boot load has finished
+ */
+struct ipc_setting_boot_load_frame_data {
+	uint32_t epoch;
+	uint32_t generation;
+	uint8_t seq;
+	uint8_t flags;
+	uint8_t record_count;
+	uint8_t records[]; //Records in ipc_setting_boot_load_data format, back to back
+};
+
+struct ipc_setting_boot_load_ack_data {
+	uint8_t seq;
+};
+
+/* Sent by the client when it starts, epoch is 0 if it does not have settings from an earlier
+ * boot load. The server boot loads the settings which changed since generation
+ */
+struct ipc_setting_boot_sync_data {
+	uint32_t epoch;
+	uint32_t generation;
+	uint8_t key_size;
+	uint8_t key[];
+};
+
+struct ipc_setting_invalidate_data {
+	uint8_t name_size; //0 to invalidate all settings
+	uint8_t name[];
+};
+
+/* Removes a subscription instead of adding it, the server counts subscriptions to a prefix */
+#define IPC_SETTING_SUBSCRIBE_FLAG_REMOVE BIT(0)
+
+struct ipc_setting_subscribe_data {
+	uint8_t flags;
+	uint8_t prefix_size; //0 for all settings
+	uint8_t prefix[];
+};
+
+struct ipc_setting_subscribe_response_data {
+	int rc;
+};
+
+/* Changes of subscribed settings, deleted settings have an empty value */
+struct ipc_setting_notify_data {
+	uint8_t record_count;
+	uint8_t records[]; //Records in ipc_setting_save_data format, back to back
+};
+
+#endif /* APP_IPC_SETTINGS_PROTOCOL_H */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/crc.h>
+#include "lorawan_nvm_encode.h"
+
+#define NVM_RLE_RUN BIT(7)
+#define NVM_RLE_MIN_RUN 3
+#define NVM_RLE_MAX_RUN ((NVM_RLE_RUN - 1) + NVM_RLE_MIN_RUN)
+#define NVM_RLE_MAX_LITERAL NVM_RLE_RUN
+
+static int rle_literal(const uint8_t *data, size_t count, uint8_t *encoded, size_t *used,
+		       size_t max_size)
+{
+	if ((*used + 1 + count) > max_size) {
+		return -ENOMEM;
+	}
+
+	encoded[*used] = count - 1;
+	memcpy(&encoded[*used + 1], data, count);
+	*used += 1 + count;
+
+	return 0;
+}
+
+int lorawan_nvm_rle_encode(const uint8_t *data, size_t size, uint8_t *encoded, size_t max_size)
+{
+	size_t used = 0;
+	size_t literal = 0;
+	size_t i = 0;
+	int rc;
+
+	while (i < size) {
+		size_t run = 1;
+
+		while ((i + run) < size && data[i + run] == data[i] && run < NVM_RLE_MAX_RUN) {
+			++run;
+		}
+
+		if (run >= NVM_RLE_MIN_RUN) {
+			if (literal > 0) {
+				rc = rle_literal(&data[i - literal], literal, encoded, &used, max_size);
+
+				if (rc != 0) {
+					return rc;
+				}
+
+				literal = 0;
+			}
+
+			if ((used + 2) > max_size) {
+				return -ENOMEM;
+			}
+
+			encoded[used] = NVM_RLE_RUN | (run - NVM_RLE_MIN_RUN);
+			encoded[used + 1] = data[i];
+			used += 2;
+			i += run;
+			continue;
+		}
+
+		++literal;
+		++i;
+
+		if (literal == NVM_RLE_MAX_LITERAL || i == size) {
+			rc = rle_literal(&data[i - literal], literal, encoded, &used, max_size);
+
+			if (rc != 0) {
+				return rc;
+			}
+
+			literal = 0;
+		}
+	}
+
+	return used;
+}
+
+int lorawan_nvm_rle_decode(const uint8_t *encoded, size_t encoded_size, uint8_t *data, size_t size)
+{
+	size_t used = 0;
+	size_t decoded = 0;
+
+	while (used < encoded_size) {
+		uint8_t header = encoded[used];
+		size_t count;
+
+		++used;
+
+		if ((header & NVM_RLE_RUN) != 0) {
+			count = (header & ~NVM_RLE_RUN) + NVM_RLE_MIN_RUN;
+
+			if (used >= encoded_size || (decoded + count) > size) {
+				return -EINVAL;
+			}
+
+			memset(&data[decoded], encoded[used], count);
+			++used;
+		} else {
+			count = header + 1;
+
+			if ((used + count) > encoded_size || (decoded + count) > size) {
+				return -EINVAL;
+			}
+
+			memcpy(&data[decoded], &encoded[used], count);
+			used += count;
+		}
+
+		decoded += count;
+	}
+
+	return (decoded == size) ? 0 : -EINVAL;
+}
+
+int lorawan_nvm_delta_encode(const uint8_t *base, const uint8_t *image, size_t size, uint8_t *delta,
+			     size_t max_size)
+{
+	struct lorawan_nvm_delta_header *header = (struct lorawan_nvm_delta_header *)delta;
+	size_t used = sizeof(struct lorawan_nvm_delta_header);
+	size_t i = 0;
+
+	header->checkpoint_crc = crc32_ieee(base, size);
+
+	while (i < size) {
+		struct lorawan_nvm_delta_range *range;
+		size_t start;
+		size_t end;
+		size_t j;
+
+		if (base[i] == image[i]) {
+			++i;
+			continue;
+		}
+
+		/* Short unchanged gaps are included in the range, a new range would cost more */
+		start = i;
+		end = i + 1;
+
+		for (j = end; j < size && (j - end) <= sizeof(struct lorawan_nvm_delta_range) &&
+			      (j - start) < UINT8_MAX; ++j) {
+			if (base[j] != image[j]) {
+				end = j + 1;
+			}
+		}
+
+		if ((used + sizeof(struct lorawan_nvm_delta_range) + (end - start)) > max_size) {
+			return -ENOMEM;
+		}
+
+		range = (struct lorawan_nvm_delta_range *)&delta[used];
+		range->offset = start;
+		range->size = end - start;
+		memcpy(range->data, &image[start], range->size);
+		used += sizeof(struct lorawan_nvm_delta_range) + range->size;
+		i = end;
+	}
+
+	return used;
+}
+
+int lorawan_nvm_delta_apply(const uint8_t *base, uint8_t *image, size_t size, const uint8_t *delta,
+			    size_t delta_size)
+{
+	const struct lorawan_nvm_delta_header *header = (const struct lorawan_nvm_delta_header *)delta;
+	size_t used = sizeof(struct lorawan_nvm_delta_header);
+
+	if (delta_size < sizeof(struct lorawan_nvm_delta_header)) {
+		return -EINVAL;
+	}
+
+	if (header->checkpoint_crc != crc32_ieee(base, size)) {
+		/* Delta belongs to a different checkpoint */
+		return -ESTALE;
+	}
+
+	while (used < delta_size) {
+		const struct lorawan_nvm_delta_range *range = (const struct lorawan_nvm_delta_range *)&delta[used];
+
+		if ((used + sizeof(struct lorawan_nvm_delta_range)) > delta_size ||
+		    (used + sizeof(struct lorawan_nvm_delta_range) + range->size) > delta_size ||
+		    (range->offset + range->size) > size) {
+			return -EINVAL;
+		}
+
+		memcpy(&image[range->offset], range->data, range->size);
+		used += sizeof(struct lorawan_nvm_delta_range) + range->size;
+	}
+
+	return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * Encodings of the LoRaWAN NVM values which are saved instead of a full group. They only work on
+ * bytes, so are also used by the storage benchmark to replay the records the client writes.
+ */
+
+#ifndef APP_LORAWAN_NVM_ENCODE_H
+#define APP_LORAWAN_NVM_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+/* A record has the values of the counters (in mask) which differ from the saved Crypto group
+ * (base), only the record with the highest sequence number that belongs to the base is applied.
+ * Each record is a single settings entry so a record is either fully written or not at all
+ */
+struct lorawan_nvm_fcnt_record {
+	uint32_t seq;
+	uint32_t base_crc;
+	uint16_t mask;
+	uint32_t values[];
+} __packed;
+
+/* A delta is a header followed by ranges of bytes which differ from the checkpoint, it is only
+ * applied if the CRC of the checkpoint matches, i.e. a newer checkpoint has not been written
+ */
+struct lorawan_nvm_delta_header {
+	uint32_t checkpoint_crc;
+} __packed;
+
+struct lorawan_nvm_delta_range {
+	uint16_t offset;
+	uint8_t size;
+	uint8_t data[];
+} __packed;
+
+/** Run length encode a group, returns the size of the encoded data or -ENOMEM if it does not fit
+ * in max_size. The encoding is a sequence of:
+ *  - 0x00-0x7f: literal, followed by (header + 1) bytes
+ *  - 0x80-0xff: run, followed by a byte which is repeated ((header & 0x7f) + 3) times
+ */
+int lorawan_nvm_rle_encode(const uint8_t *data, size_t size, uint8_t *encoded, size_t max_size);
+
+/** Decode a run length encoded group, returns -EINVAL if it does not decode to size bytes */
+int lorawan_nvm_rle_decode(const uint8_t *encoded, size_t encoded_size, uint8_t *data, size_t size);
+
+/** Encode the bytes of image which differ from base, returns the size of the delta or -ENOMEM if
+ * it does not fit in max_size
+ */
+int lorawan_nvm_delta_encode(const uint8_t *base, const uint8_t *image, size_t size, uint8_t *delta,
+			     size_t max_size);
+
+/** Apply a delta to image, which must hold a copy of the checkpoint base. Returns -ESTALE if the
+ * delta belongs to a different checkpoint
+ */
+int lorawan_nvm_delta_apply(const uint8_t *base, uint8_t *image, size_t size, const uint8_t *delta,
+			    size_t delta_size);
+
+#endif /* APP_LORAWAN_NVM_ENCODE_H */
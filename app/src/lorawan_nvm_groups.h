@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#ifndef APP_LORAWAN_NVM_GROUPS_H
+#define APP_LORAWAN_NVM_GROUPS_H
+
+#define LORAWAN_SETTINGS_BASE "lorawan/nvm"
+#define LORAWAN_SETTINGS_DELTA "d"
+#define LORAWAN_SETTINGS_FCNT "fcnt"
+
+/*
+ * LoRaMac NVM groups as (ID, member of LoRaMacNvmData_t), F is called with X passed through. A
+ * group is saved as LORAWAN_SETTINGS_BASE/<member>, its delta under that as
+ * LORAWAN_SETTINGS_DELTA and it is reported with LORAMAC_NVM_NOTIFY_FLAG_<ID>. Used for both the
+ * NVM setting descriptors and the IPC setting IDs, a new group goes at the end so that the IDs
+ * of the existing groups do not change
+ */
+#define LORAWAN_NVM_GROUP_LIST(F, X)						\
+	F(X, CRYPTO, Crypto)							\
+	F(X, MAC_GROUP1, MacGroup1)						\
+	F(X, MAC_GROUP2, MacGroup2)						\
+	F(X, SECURE_ELEMENT, SecureElement)					\
+	F(X, REGION_GROUP1, RegionGroup1)					\
+	F(X, REGION_GROUP2, RegionGroup2)					\
+	F(X, CLASS_B, ClassB)
+
+/* Frame counter journal slots, saved as LORAWAN_SETTINGS_BASE/LORAWAN_SETTINGS_FCNT/<slot>.
+ * CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS can be up to LORAWAN_NVM_FCNT_MAX_SLOTS. The IPC setting
+ * IDs of the groups follow those of the slots, so the number of slots must not change
+ */
+#define LORAWAN_NVM_FCNT_MAX_SLOTS 32
+
+#define LORAWAN_NVM_FCNT_SLOT_LIST(F, X)					\
+	F(X, 0) F(X, 1) F(X, 2) F(X, 3) F(X, 4) F(X, 5) F(X, 6) F(X, 7)		\
+	F(X, 8) F(X, 9) F(X, 10) F(X, 11) F(X, 12) F(X, 13) F(X, 14) F(X, 15)	\
+	F(X, 16) F(X, 17) F(X, 18) F(X, 19) F(X, 20) F(X, 21) F(X, 22) F(X, 23)	\
+	F(X, 24) F(X, 25) F(X, 26) F(X, 27) F(X, 28) F(X, 29) F(X, 30) F(X, 31)
+
+#endif /* APP_LORAWAN_NVM_GROUPS_H */
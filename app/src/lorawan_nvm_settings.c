@@ -9,14 +9,47 @@
 #include <zephyr/kernel.h>
 #include <zephyr/settings/settings.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/pm/policy.h>
 #include "lorawan_nvm_settings.h"
+#include "lorawan_nvm_encode.h"
+#include "ipc_settings.h"
 
 LOG_MODULE_REGISTER(lorawan_nvm, CONFIG_LORAWAN_LOG_LEVEL);
 
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+#define NVM_SETTING_COMPRESS_VALUE(_name) \
+	static uint16_t setting_stored_size_ ## _name;
+
+#define NVM_SETTING_COMPRESS_DESCR(_member)					\
+		.stored_size = &setting_stored_size_ ## _member,
+#else
+#define NVM_SETTING_COMPRESS_VALUE(_name)
+#define NVM_SETTING_COMPRESS_DESCR(_member)
+#endif
+
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
 #define NVM_SETTING_VALUE_DESCR(_name) \
 	static uint8_t setting_value_ ## _name[sizeof(((LoRaMacNvmData_t *)0)->_name)]; \
+	NVM_SETTING_COMPRESS_VALUE(_name) \
+	static bool setting_loaded_ ## _name; \
+	static uint8_t setting_delta_ ## _name[CONFIG_LORAWAN_NVM_DELTA_MAX_SIZE]; \
+	static uint8_t setting_delta_size_ ## _name
+
+#define NVM_SETTING_DELTA_DESCR(_member)					\
+		.delta_setting_name = LORAWAN_SETTINGS_BASE "/" STRINGIFY(_member) \
+				      "/" LORAWAN_SETTINGS_DELTA,		\
+		.delta = setting_delta_ ## _member,				\
+		.delta_size = &setting_delta_size_ ## _member,
+#else
+#define NVM_SETTING_VALUE_DESCR(_name) \
+	static uint8_t setting_value_ ## _name[sizeof(((LoRaMacNvmData_t *)0)->_name)]; \
+	NVM_SETTING_COMPRESS_VALUE(_name) \
 	static bool setting_loaded_ ## _name
 
+#define NVM_SETTING_DELTA_DESCR(_member)
+#endif
+
 #define NVM_SETTING_DESCR(_flag, _member)				\
 	{								\
 		.flag = _flag,						\
@@ -27,70 +60,740 @@ LOG_MODULE_REGISTER(lorawan_nvm, CONFIG_LORAWAN_LOG_LEVEL);
 		.size = sizeof(((LoRaMacNvmData_t *)0)->_member),	\
 		.data = setting_value_ ## _member,			\
 		.loaded = &setting_loaded_ ## _member,			\
+		NVM_SETTING_DELTA_DESCR(_member)			\
+		NVM_SETTING_COMPRESS_DESCR(_member)			\
 	}
 
-NVM_SETTING_VALUE_DESCR(Crypto);
-NVM_SETTING_VALUE_DESCR(MacGroup1);
-NVM_SETTING_VALUE_DESCR(MacGroup2);
-NVM_SETTING_VALUE_DESCR(SecureElement);
-NVM_SETTING_VALUE_DESCR(RegionGroup2);
+#define NVM_SETTING_GROUP_VALUE(X, _id, _member) NVM_SETTING_VALUE_DESCR(_member);
+#define NVM_SETTING_GROUP_DESCR(X, _id, _member)				\
+	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_ ## _id, _member),
 
+LORAWAN_NVM_GROUP_LIST(NVM_SETTING_GROUP_VALUE, _)
+
+/* Groups come from LORAWAN_NVM_GROUP_LIST, which also gives their setting names IPC IDs */
 static const struct lorawan_nvm_setting_descr nvm_setting_descriptors[] = {
-	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_CRYPTO, Crypto),
-	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1, MacGroup1),
-	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2, MacGroup2),
-	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT, SecureElement),
-	NVM_SETTING_DESCR(LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2, RegionGroup2),
+	LORAWAN_NVM_GROUP_LIST(NVM_SETTING_GROUP_DESCR, _)
 };
 
 const uint16_t lorawan_nvm_settings_entries = ARRAY_SIZE(nvm_setting_descriptors);
 
-static void lorawan_nvm_save_settings(uint16_t nvm_notify_flag)
+static struct lorawan_nvm_stats nvm_stats;
+static K_MUTEX_DEFINE(nvm_stats_lock);
+
+/* Counts of the save in progress, only used by the thread which saves and added to nvm_stats
+ * under nvm_stats_lock when the save finishes
+ */
+static struct lorawan_nvm_stats nvm_save_stats;
+
+/* Hash of the contents of each group as last saved (or restored), a group which is reported as
+ * changed but has the same contents is not saved again
+ */
+static struct {
+	uint32_t hash;
+	bool valid;
+} nvm_saved_hashes[ARRAY_SIZE(nvm_setting_descriptors)];
+
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+#define NVM_FCNT_COUNTER(_member)						\
+	{									\
+		.offset = offsetof(LoRaMacCryptoNvmData_t, _member),		\
+		.size = sizeof(((LoRaMacCryptoNvmData_t *)0)->_member),		\
+	}
+
+/* Counters of the Crypto group which are written to the journal */
+static const struct {
+	uint8_t offset;
+	uint8_t size;
+} nvm_fcnt_counters[] = {
+	NVM_FCNT_COUNTER(DevNonce),
+	NVM_FCNT_COUNTER(FCntList.FCntUp),
+	NVM_FCNT_COUNTER(FCntList.NFCntDown),
+	NVM_FCNT_COUNTER(FCntList.AFCntDown),
+	NVM_FCNT_COUNTER(FCntList.FCntDown),
+	NVM_FCNT_COUNTER(FCntList.McFCntDown[0]),
+	NVM_FCNT_COUNTER(FCntList.McFCntDown[1]),
+	NVM_FCNT_COUNTER(FCntList.McFCntDown[2]),
+	NVM_FCNT_COUNTER(FCntList.McFCntDown[3]),
+	NVM_FCNT_COUNTER(LastDownFCnt),
+};
+
+#define NVM_FCNT_RECORD_MAX_SIZE \
+	(sizeof(struct lorawan_nvm_fcnt_record) + (ARRAY_SIZE(nvm_fcnt_counters) * sizeof(uint32_t)))
+
+static struct {
+	LoRaMacCryptoNvmData_t base;
+	bool base_valid;
+	uint8_t records;
+	uint32_t next_seq;
+	uint8_t sizes[CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS];
+	uint8_t slots[CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS][NVM_FCNT_RECORD_MAX_SIZE];
+} nvm_fcnt;
+
+BUILD_ASSERT(ARRAY_SIZE(nvm_fcnt_counters) <= 16, "Journal counter mask is too small");
+BUILD_ASSERT(CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS <= LORAWAN_NVM_FCNT_MAX_SLOTS,
+	     "Journal slots need IPC setting IDs");
+
+int lorawan_nvm_fcnt_journal_set(uint8_t slot, size_t len, settings_read_cb read_cb, void *cb_arg)
 {
-	MibRequestConfirm_t mib_req;
-	LoRaMacNvmData_t *nvm;
+	int rc;
 
-	LOG_DBG("Saving LoRaWAN settings");
+	if (slot >= CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS) {
+		return -ENOENT;
+	}
 
-	/* Retrieve the actual context */
-	mib_req.Type = MIB_NVM_CTXS;
+	if (len > NVM_FCNT_RECORD_MAX_SIZE) {
+		return -E2BIG;
+	}
 
-	if (LoRaMacMibGetRequestConfirm(&mib_req) != LORAMAC_STATUS_OK) {
-		LOG_ERR("Could not get NVM context");
-		return;
+	rc = read_cb(cb_arg, nvm_fcnt.slots[slot], len);
+
+	if (rc < 0) {
+		return rc;
+	}
+
+	nvm_fcnt.sizes[slot] = rc;
+
+	return 0;
+}
+
+/* Writes a journal record if only counters changed since the base was saved, returns -EAGAIN if
+ * the Crypto group needs to be saved instead
+ */
+static int nvm_fcnt_journal_save(const LoRaMacCryptoNvmData_t *crypto)
+{
+	LoRaMacCryptoNvmData_t check;
+	uint8_t buffer[NVM_FCNT_RECORD_MAX_SIZE];
+	struct lorawan_nvm_fcnt_record *record = (struct lorawan_nvm_fcnt_record *)buffer;
+	char name[sizeof(LORAWAN_SETTINGS_BASE "/" LORAWAN_SETTINGS_FCNT "/") + 3];
+	uint8_t count = 0;
+	uint8_t size;
+	uint8_t i;
+	int rc;
+
+	if (!nvm_fcnt.base_valid || nvm_fcnt.records >= CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS) {
+		return -EAGAIN;
+	}
+
+	/* Everything apart from the counters and CRC must be the same as the base */
+	memcpy(&check, crypto, sizeof(check));
+	check.Crc = nvm_fcnt.base.Crc;
+	record->mask = 0;
+
+	for (i = 0; i < ARRAY_SIZE(nvm_fcnt_counters); ++i) {
+		uint8_t *value = (uint8_t *)&check + nvm_fcnt_counters[i].offset;
+		const uint8_t *base_value = (const uint8_t *)&nvm_fcnt.base + nvm_fcnt_counters[i].offset;
+
+		if (memcmp(value, base_value, nvm_fcnt_counters[i].size) != 0) {
+			record->mask |= BIT(i);
+			record->values[count] = 0;
+			memcpy(&record->values[count], value, nvm_fcnt_counters[i].size);
+			memcpy(value, base_value, nvm_fcnt_counters[i].size);
+			++count;
+		}
+	}
+
+	if (memcmp(&check, &nvm_fcnt.base, sizeof(check)) != 0) {
+		return -EAGAIN;
+	}
+
+	record->seq = nvm_fcnt.next_seq;
+	record->base_crc = nvm_fcnt.base.Crc;
+	size = sizeof(struct lorawan_nvm_fcnt_record) + (count * sizeof(uint32_t));
+
+	(void)snprintk(name, sizeof(name), LORAWAN_SETTINGS_BASE "/" LORAWAN_SETTINGS_FCNT "/%d",
+		       (record->seq % CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS));
+
+	LOG_DBG("Saving frame counter journal record %"PRIu32" (%d counters)", record->seq, count);
+	rc = settings_save_one(name, buffer, size);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	++nvm_fcnt.next_seq;
+	++nvm_fcnt.records;
+	++nvm_save_stats.journal_writes;
+	nvm_save_stats.journal_bytes += size;
+
+	return 0;
+}
+
+/* Sets the base once the Crypto group has been saved, existing records no longer apply */
+static void nvm_fcnt_journal_reset(const LoRaMacCryptoNvmData_t *crypto, bool valid)
+{
+	memcpy(&nvm_fcnt.base, crypto, sizeof(nvm_fcnt.base));
+	nvm_fcnt.base_valid = valid;
+	nvm_fcnt.records = 0;
+}
+
+/* Applies the newest journal record of the restored Crypto group and updates the CRC */
+static void nvm_fcnt_journal_restore(LoRaMacCryptoNvmData_t *crypto, bool loaded)
+{
+	const struct lorawan_nvm_fcnt_record *newest = NULL;
+	uint8_t records = 0;
+	uint8_t i;
+
+	for (i = 0; i < CONFIG_LORAWAN_NVM_FCNT_JOURNAL_SLOTS; ++i) {
+		const struct lorawan_nvm_fcnt_record *record = (const struct lorawan_nvm_fcnt_record *)nvm_fcnt.slots[i];
+
+		if (nvm_fcnt.sizes[i] < sizeof(struct lorawan_nvm_fcnt_record)) {
+			continue;
+		}
+
+		if (record->seq >= nvm_fcnt.next_seq) {
+			nvm_fcnt.next_seq = record->seq + 1;
+		}
+
+		if (!loaded || record->base_crc != crypto->Crc ||
+		    nvm_fcnt.sizes[i] < (sizeof(struct lorawan_nvm_fcnt_record) +
+					 (__builtin_popcount(record->mask) * sizeof(uint32_t)))) {
+			continue;
+		}
+
+		++records;
+
+		if (newest == NULL || record->seq > newest->seq) {
+			newest = record;
+		}
+	}
+
+	nvm_fcnt_journal_reset(crypto, loaded);
+	nvm_fcnt.records = records;
+
+	if (newest != NULL) {
+		uint8_t count = 0;
+
+		for (i = 0; i < ARRAY_SIZE(nvm_fcnt_counters); ++i) {
+			if (newest->mask & BIT(i)) {
+				memcpy(((uint8_t *)crypto + nvm_fcnt_counters[i].offset),
+				       &newest->values[count], nvm_fcnt_counters[i].size);
+				++count;
+			}
+		}
+
+		crypto->Crc = crc32_ieee((uint8_t *)crypto, offsetof(LoRaMacCryptoNvmData_t, Crc));
+
+		LOG_DBG("Frame counter journal record %"PRIu32" applied, FCntUp: %"PRIu32,
+			newest->seq, crypto->FCntList.FCntUp);
+	}
+}
+#endif
+
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+/* Groups written in full are run length encoded, the channel and band tables are mostly zeros.
+ * A group is only stored compressed if that is smaller than the group, so a stored value with the
+ * size of the group is not compressed
+ */
+#define NVM_GROUP_SIZE(_member) sizeof(((LoRaMacNvmData_t *)0)->_member)
+
+#define NVM_GROUP_BUFFER(X, _id, _member) uint8_t _member[NVM_GROUP_SIZE(_member)];
+
+union nvm_group_buffer {
+	LORAWAN_NVM_GROUP_LIST(NVM_GROUP_BUFFER, _)
+};
+
+/* Holds a group whilst it is encoded for saving or decoded when restoring, the NVM data is only
+ * restored before the MAC is started so these are never done at the same time
+ */
+static uint8_t nvm_compress_buffer[sizeof(union nvm_group_buffer)];
+
+/* Replaces the compressed group loaded into data with the decoded group */
+static int nvm_group_decode(const struct lorawan_nvm_setting_descr *descr)
+{
+	int rc;
+
+	rc = lorawan_nvm_rle_decode(descr->data, *descr->stored_size, nvm_compress_buffer, descr->size);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	memcpy(descr->data, nvm_compress_buffer, descr->size);
+	*descr->stored_size = descr->size;
+
+	return 0;
+}
+#endif
+
+/* Writes a group in full (compressed if enabled and smaller), returns the number of bytes
+ * written
+ */
+static int nvm_group_write(const struct lorawan_nvm_setting_descr *descr, const uint8_t *image)
+{
+	const uint8_t *value = image;
+	int size = descr->size;
+	int rc;
+
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+	rc = lorawan_nvm_rle_encode(image, descr->size, nvm_compress_buffer, (descr->size - 1));
+
+	if (rc >= 0) {
+		LOG_DBG("Compressed " LORAWAN_SETTINGS_BASE "/%s: %d of %d bytes", descr->name, rc,
+			descr->size);
+		value = nvm_compress_buffer;
+		size = rc;
+		nvm_save_stats.compressed_bytes += descr->size - rc;
+	}
+#endif
+
+	rc = settings_save_one(descr->setting_name, value, size);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	return size;
+}
+
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+/* Number of delta saves since the last checkpoint of each group, a group is checkpointed when
+ * this reaches CONFIG_LORAWAN_NVM_DELTA_CHECKPOINT_INTERVAL
+ */
+static uint16_t nvm_delta_saves[ARRAY_SIZE(nvm_setting_descriptors)];
+
+/* Whether storage may hold a delta of each group, only then is it deleted when a checkpoint is
+ * written. Not known until a checkpoint has been written after startup
+ */
+static bool nvm_delta_stored[ARRAY_SIZE(nvm_setting_descriptors)] = {
+	[0 ... (ARRAY_SIZE(nvm_setting_descriptors) - 1)] = true,
+};
+
+/* Saves a group as a delta against its checkpoint, or as a new checkpoint */
+static int nvm_delta_save(uint32_t index, const uint8_t *image)
+{
+	const struct lorawan_nvm_setting_descr *descr = &nvm_setting_descriptors[index];
+	uint8_t delta[CONFIG_LORAWAN_NVM_DELTA_MAX_SIZE];
+	int rc = -ENOMEM;
+
+	if (*descr->loaded == true &&
+	    nvm_delta_saves[index] < CONFIG_LORAWAN_NVM_DELTA_CHECKPOINT_INTERVAL) {
+		rc = lorawan_nvm_delta_encode(descr->data, image, descr->size, delta, sizeof(delta));
+	}
+
+	if (rc >= 0) {
+		LOG_DBG("Saving delta of " LORAWAN_SETTINGS_BASE "/%s: %d of %d bytes", descr->name,
+			rc, descr->size);
+		++nvm_delta_saves[index];
+		nvm_delta_stored[index] = true;
+		nvm_save_stats.group_bytes += rc;
+
+		return settings_save_one(descr->delta_setting_name, delta, rc);
+	}
+
+	LOG_DBG("Saving checkpoint of " LORAWAN_SETTINGS_BASE "/%s: %d bytes", descr->name,
+		descr->size);
+
+	rc = nvm_group_write(descr, image);
+
+	if (rc < 0) {
+		return rc;
+	}
+
+	nvm_save_stats.group_bytes += rc;
+	memcpy(descr->data, image, descr->size);
+	*descr->loaded = true;
+	*descr->delta_size = 0;
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+	*descr->stored_size = descr->size;
+#endif
+	nvm_delta_saves[index] = 0;
+
+	if (!nvm_delta_stored[index]) {
+		return 0;
+	}
+
+	/* The previous delta does not match the new checkpoint, remove it so it is not loaded */
+	rc = settings_delete(descr->delta_setting_name);
+
+	if (rc == 0) {
+		nvm_delta_stored[index] = false;
+	}
+
+	return rc;
+}
+#endif
+
+/* Saves the groups in nvm_notify_flag which changed, returns an error if any of them may not have
+ * been written
+ */
+static int lorawan_nvm_save_settings(const LoRaMacNvmData_t *nvm, uint16_t nvm_notify_flag)
+{
+	int rc;
+	int err = 0;
+	uint16_t saved = 0;
+	uint16_t changed = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+	uint32_t hashes[ARRAY_SIZE(nvm_setting_descriptors)];
+	uint32_t save_us;
+	int64_t start = k_uptime_ticks();
+	bool journal_only = false;
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
+		const struct lorawan_nvm_setting_descr *descr = &nvm_setting_descriptors[i];
+
+		if ((nvm_notify_flag & descr->flag) != descr->flag) {
+			continue;
+		}
+
+		hashes[i] = crc32_ieee(((const uint8_t *)nvm + descr->offset), descr->size);
+
+		if (nvm_saved_hashes[i].valid && nvm_saved_hashes[i].hash == hashes[i]) {
+			LOG_DBG("Configuration " LORAWAN_SETTINGS_BASE "/%s unchanged", descr->name);
+			++nvm_save_stats.skipped;
+		} else {
+			changed |= descr->flag;
+		}
+	}
+
+	nvm_notify_flag = changed;
+
+	if (nvm_notify_flag == LORAMAC_NVM_NOTIFY_FLAG_NONE) {
+		(void)k_mutex_lock(&nvm_stats_lock, K_FOREVER);
+		nvm_stats.skipped += nvm_save_stats.skipped;
+		k_mutex_unlock(&nvm_stats_lock);
+		nvm_save_stats.skipped = 0;
+
+		return 0;
 	}
 
-	nvm = mib_req.Param.Contexts;
+	LOG_DBG("Saving LoRaWAN settings");
 
 	LOG_DBG("Crypto version: %"PRIu32", DevNonce: %d, JoinNonce: %"PRIu32,
-		mib_req.Param.Contexts->Crypto.LrWanVersion.Value,
-		mib_req.Param.Contexts->Crypto.DevNonce,
-		mib_req.Param.Contexts->Crypto.JoinNonce);
+		nvm->Crypto.LrWanVersion.Value, nvm->Crypto.DevNonce, nvm->Crypto.JoinNonce);
+
+	/* All changed groups are sent to the server in one batch and written as one transaction, so
+	 * a restart or failed save cannot leave only some of them updated
+	 */
+	(void)ipc_setting_batch_begin();
+
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+	if ((nvm_notify_flag & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO) != 0) {
+		rc = nvm_fcnt_journal_save(&nvm->Crypto);
+
+		if (rc == 0) {
+			nvm_notify_flag &= ~LORAMAC_NVM_NOTIFY_FLAG_CRYPTO;
+			journal_only = (nvm_notify_flag == LORAMAC_NVM_NOTIFY_FLAG_NONE);
+		} else if (rc != -EAGAIN) {
+			LOG_ERR("Could not save frame counter journal: %d", rc);
+		}
+	}
+#endif
 
 	for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
 		const struct lorawan_nvm_setting_descr *descr =
 			&nvm_setting_descriptors[i];
 
 		if ((nvm_notify_flag & descr->flag) == descr->flag) {
-			int rc;
-
 			LOG_DBG("Saving configuration " LORAWAN_SETTINGS_BASE "/%s", descr->name);
-			rc = settings_save_one(descr->setting_name, (char *)nvm + descr->offset,
-					       descr->size);
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+			rc = nvm_delta_save(i, (uint8_t *)nvm + descr->offset);
+#else
+			rc = nvm_group_write(descr, (uint8_t *)nvm + descr->offset);
+
+			if (rc >= 0) {
+				nvm_save_stats.group_bytes += rc;
+				rc = 0;
+			}
+#endif
 
 			if (rc != 0) {
 				LOG_ERR("Could not save setting " LORAWAN_SETTINGS_BASE "/%s: %d",
 					descr->name, rc);
+
+				if (err == 0) {
+					err = rc;
+				}
+			}
+
+			saved |= descr->flag;
+			++nvm_save_stats.group_writes;
+		}
+	}
+
+	rc = ipc_setting_batch_end(false);
+
+	if (rc == 0) {
+		rc = err;
+	}
+
+	/* Groups which were saved (or journaled) now have these contents in storage, if the save
+	 * failed the contents in storage are unknown
+	 */
+	for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
+		if ((changed & nvm_setting_descriptors[i].flag) != 0) {
+			nvm_saved_hashes[i].hash = hashes[i];
+			nvm_saved_hashes[i].valid = (rc == 0);
+		}
+	}
+
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+	if ((saved & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO) != 0) {
+		/* Base is unknown if the save failed, the group is saved again next time */
+		nvm_fcnt_journal_reset(&nvm->Crypto, (rc == 0));
+	} else if (rc != 0) {
+		nvm_fcnt.base_valid = false;
+	}
+#endif
+
+	save_us = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+	(void)k_mutex_lock(&nvm_stats_lock, K_FOREVER);
+	++nvm_stats.saves;
+	nvm_stats.max_save_us = MAX(nvm_stats.max_save_us, save_us);
+	nvm_stats.journal_writes += nvm_save_stats.journal_writes;
+	nvm_stats.journal_bytes += nvm_save_stats.journal_bytes;
+	nvm_stats.group_writes += nvm_save_stats.group_writes;
+	nvm_stats.group_bytes += nvm_save_stats.group_bytes;
+	nvm_stats.compressed_bytes += nvm_save_stats.compressed_bytes;
+	nvm_stats.skipped += nvm_save_stats.skipped;
+
+	if (journal_only) {
+		++nvm_stats.journal_saves;
+		nvm_stats.journal_save_us += save_us;
+	} else {
+		nvm_stats.group_save_us += save_us;
+	}
+
+	k_mutex_unlock(&nvm_stats_lock);
+	memset(&nvm_save_stats, 0, sizeof(nvm_save_stats));
+
+	LOG_DBG("LoRaWAN settings saved in %"PRIu32" us (%s), rc: %d", save_us,
+		(journal_only ? "journal" : "groups"), rc);
+
+	if (rc != 0) {
+		LOG_ERR("Could not write LoRaWAN settings: %d", rc);
+
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+		/* What is in storage is unknown, write a checkpoint of these groups next time */
+		for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
+			if ((saved & nvm_setting_descriptors[i].flag) != 0) {
+				nvm_delta_saves[i] = CONFIG_LORAWAN_NVM_DELTA_CHECKPOINT_INTERVAL;
+				nvm_delta_stored[i] = true;
 			}
 		}
+#endif
+	}
+
+	return rc;
+}
+
+#if defined(CONFIG_LORAWAN_NVM_WRITE_BEHIND)
+/* Changed groups are copied to pending by the MAC and saved from a copy of pending by the write
+ * behind thread, so that the MAC never waits for storage
+ */
+static struct {
+	uint16_t pending_flags;
+	uint32_t pending_seq;
+	uint32_t saved_seq;
+	/* Sequence and error of the last save which failed */
+	uint32_t failed_seq;
+	int failed_rc;
+	bool pm_locked;
+	LoRaMacNvmData_t pending;
+	LoRaMacNvmData_t writing;
+} nvm_write_behind;
+
+static K_MUTEX_DEFINE(nvm_write_behind_lock);
+static K_CONDVAR_DEFINE(nvm_write_behind_saved);
+static K_SEM_DEFINE(nvm_write_behind_work, 0, 1);
+static K_SEM_DEFINE(nvm_write_behind_flush, 0, 1);
+
+static void nvm_copy_groups(LoRaMacNvmData_t *destination, const LoRaMacNvmData_t *source,
+			    uint16_t flags)
+{
+	for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
+		const struct lorawan_nvm_setting_descr *descr = &nvm_setting_descriptors[i];
+
+		if ((flags & descr->flag) == descr->flag) {
+			memcpy(((uint8_t *)destination + descr->offset),
+			       ((const uint8_t *)source + descr->offset), descr->size);
+		}
+	}
+}
+
+static void nvm_write_behind_thread(void *p1, void *p2, void *p3)
+{
+	uint16_t flags;
+	uint32_t seq;
+	int rc;
+
+	while (1) {
+		(void)k_sem_take(&nvm_write_behind_work, K_FOREVER);
+
+		/* Further changes made by the MAC in this time are saved together, unless flushing */
+		(void)k_sem_take(&nvm_write_behind_flush,
+				 K_MSEC(CONFIG_LORAWAN_NVM_WRITE_BEHIND_DELAY_MS));
+
+		(void)k_mutex_lock(&nvm_write_behind_lock, K_FOREVER);
+		flags = nvm_write_behind.pending_flags;
+		seq = nvm_write_behind.pending_seq;
+		nvm_copy_groups(&nvm_write_behind.writing, &nvm_write_behind.pending, flags);
+		nvm_write_behind.pending_flags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+		k_mutex_unlock(&nvm_write_behind_lock);
+
+		rc = 0;
+
+		if (flags != LORAMAC_NVM_NOTIFY_FLAG_NONE) {
+			rc = lorawan_nvm_save_settings(&nvm_write_behind.writing, flags);
+		}
+
+		(void)k_mutex_lock(&nvm_write_behind_lock, K_FOREVER);
+
+		if (rc == 0) {
+			nvm_write_behind.saved_seq = seq;
+		} else {
+			/* Pending still has the contents of these groups (or newer ones if the MAC
+			 * changed them since), they are saved again with the next change or flush
+			 */
+			nvm_write_behind.pending_flags |= flags;
+			nvm_write_behind.failed_seq = seq;
+			nvm_write_behind.failed_rc = rc;
+		}
+
+		if (nvm_write_behind.pending_flags == LORAMAC_NVM_NOTIFY_FLAG_NONE &&
+		    nvm_write_behind.pm_locked) {
+			pm_policy_state_lock_put(PM_STATE_SOFT_OFF, PM_ALL_SUBSTATES);
+			nvm_write_behind.pm_locked = false;
+		}
+
+		k_condvar_broadcast(&nvm_write_behind_saved);
+		k_mutex_unlock(&nvm_write_behind_lock);
+	}
+}
+
+K_THREAD_DEFINE(lorawan_nvm_write_behind, CONFIG_LORAWAN_NVM_WRITE_BEHIND_STACK_SIZE,
+		nvm_write_behind_thread, NULL, NULL, NULL,
+		CONFIG_LORAWAN_NVM_WRITE_BEHIND_THREAD_PRIORITY, 0, 0);
+
+int lorawan_nvm_flush(k_timeout_t timeout)
+{
+	int rc = 0;
+	uint32_t target;
+
+	(void)k_mutex_lock(&nvm_write_behind_lock, K_FOREVER);
+	target = nvm_write_behind.pending_seq;
+
+	if (nvm_write_behind.saved_seq != target) {
+		/* A new sequence makes changes left pending by a failed save be saved again */
+		target = ++nvm_write_behind.pending_seq;
+		k_sem_give(&nvm_write_behind_work);
+		k_sem_give(&nvm_write_behind_flush);
+	}
+
+	while ((int32_t)(nvm_write_behind.saved_seq - target) < 0) {
+		if ((int32_t)(nvm_write_behind.failed_seq - target) >= 0) {
+			rc = nvm_write_behind.failed_rc;
+			break;
+		}
+
+		rc = k_condvar_wait(&nvm_write_behind_saved, &nvm_write_behind_lock, timeout);
+
+		if (rc != 0) {
+			rc = -ETIMEDOUT;
+			break;
+		}
 	}
+
+	k_mutex_unlock(&nvm_write_behind_lock);
+
+	return rc;
+}
+
+#if defined(CONFIG_REBOOT) || defined(CONFIG_POWEROFF)
+#define NVM_SHUTDOWN_FLUSH_TIMEOUT K_SECONDS(2)
+
+static void nvm_shutdown_flush(void)
+{
+	int rc;
+
+	/* Cannot wait in an interrupt, or for the save thread from itself */
+	if (k_is_in_isr() || k_current_get() == lorawan_nvm_write_behind) {
+		return;
+	}
+
+	rc = lorawan_nvm_flush(NVM_SHUTDOWN_FLUSH_TIMEOUT);
+
+	if (rc != 0) {
+		LOG_ERR("LoRaWAN NVM changes not written before shutdown: %d", rc);
+	}
+}
+#endif
+
+/* Linked in place of sys_reboot() and sys_poweroff() (see remote/CMakeLists.txt), so pending
+ * changes are written whoever resets or powers off the core
+ */
+#if defined(CONFIG_REBOOT)
+FUNC_NORETURN void __real_sys_reboot(int type);
+
+FUNC_NORETURN void __wrap_sys_reboot(int type)
+{
+	nvm_shutdown_flush();
+	__real_sys_reboot(type);
 }
+#endif
+
+#if defined(CONFIG_POWEROFF)
+FUNC_NORETURN void __real_sys_poweroff(void);
+
+FUNC_NORETURN void __wrap_sys_poweroff(void)
+{
+	nvm_shutdown_flush();
+	__real_sys_poweroff();
+}
+#endif
+#else
+/* Groups whose last save failed and the error, they are saved again with the next change */
+static uint16_t nvm_unsaved_flags;
+static int nvm_unsaved_rc;
+
+int lorawan_nvm_flush(k_timeout_t timeout)
+{
+	/* Saves are synchronous */
+	return (nvm_unsaved_flags != LORAMAC_NVM_NOTIFY_FLAG_NONE ? nvm_unsaved_rc : 0);
+}
+#endif
 
 void lorawan_nvm_data_mgmt_event(uint16_t flags)
 {
-	if (flags != LORAMAC_NVM_NOTIFY_FLAG_NONE) {
-		lorawan_nvm_save_settings(flags);
+	MibRequestConfirm_t mib_req;
+
+	if (flags == LORAMAC_NVM_NOTIFY_FLAG_NONE) {
+		return;
 	}
+
+	/* Retrieve the actual context */
+	mib_req.Type = MIB_NVM_CTXS;
+
+	if (LoRaMacMibGetRequestConfirm(&mib_req) != LORAMAC_STATUS_OK) {
+		LOG_ERR("Could not get NVM context");
+		return;
+	}
+
+#if defined(CONFIG_LORAWAN_NVM_WRITE_BEHIND)
+	(void)k_mutex_lock(&nvm_write_behind_lock, K_FOREVER);
+	nvm_copy_groups(&nvm_write_behind.pending, mib_req.Param.Contexts, flags);
+
+	if (nvm_write_behind.pending_flags != LORAMAC_NVM_NOTIFY_FLAG_NONE) {
+		(void)k_mutex_lock(&nvm_stats_lock, K_FOREVER);
+		++nvm_stats.coalesced;
+		k_mutex_unlock(&nvm_stats_lock);
+	}
+
+	nvm_write_behind.pending_flags |= flags;
+	++nvm_write_behind.pending_seq;
+
+	/* Power off is not allowed until the changes have been written, only with CONFIG_PM */
+	if (!nvm_write_behind.pm_locked) {
+		pm_policy_state_lock_get(PM_STATE_SOFT_OFF, PM_ALL_SUBSTATES);
+		nvm_write_behind.pm_locked = true;
+	}
+
+	k_mutex_unlock(&nvm_write_behind_lock);
+	k_sem_give(&nvm_write_behind_work);
+#else
+	flags |= nvm_unsaved_flags;
+	nvm_unsaved_rc = lorawan_nvm_save_settings(mib_req.Param.Contexts, flags);
+	nvm_unsaved_flags = (nvm_unsaved_rc == 0 ? LORAMAC_NVM_NOTIFY_FLAG_NONE : flags);
+#endif
 }
 
 int lorawan_nvm_data_restore(void)
@@ -98,6 +801,11 @@ int lorawan_nvm_data_restore(void)
 	int err;
 	LoRaMacStatus_t status;
 	MibRequestConfirm_t mib_req;
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+	int64_t start = k_uptime_ticks();
+	uint16_t decompressed = 0;
+	uint32_t decompress_us;
+#endif
 
 	LOG_DBG("Restoring LoRaWAN settings");
 
@@ -114,13 +822,62 @@ int lorawan_nvm_data_restore(void)
 		const struct lorawan_nvm_setting_descr *descr =
 			&nvm_setting_descriptors[i];
 
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+		if (*descr->loaded == true && *descr->stored_size < descr->size) {
+			err = nvm_group_decode(descr);
+
+			if (err != 0) {
+				/* Group is left at its default, next save writes it in full */
+				LOG_ERR("Could not decompress %s: %d", descr->name, err);
+				*descr->loaded = false;
+			} else {
+				++decompressed;
+			}
+		}
+#endif
+
 		if (*descr->loaded == true) {
-LOG_ERR("value %s to %p from %p", descr->name, (void *)((char *)mib_req.Param.Contexts + descr->offset), (void *)descr->data);
 			memcpy(((char *)mib_req.Param.Contexts + descr->offset), descr->data, descr->size);
-LOG_HEXDUMP_ERR(descr->data, descr->size, "data");
+
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+			if (*descr->delta_size > 0) {
+				err = lorawan_nvm_delta_apply(descr->data,
+							      ((uint8_t *)mib_req.Param.Contexts + descr->offset),
+							      descr->size, descr->delta, *descr->delta_size);
+
+				if (err != 0) {
+					/* Checkpoint is used as is, next save writes a new one */
+					LOG_WRN("Delta of %s not applied: %d", descr->name, err);
+					nvm_delta_saves[i] = CONFIG_LORAWAN_NVM_DELTA_CHECKPOINT_INTERVAL;
+				}
+			}
+#endif
 		}
 	}
 
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+	decompress_us = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+	(void)k_mutex_lock(&nvm_stats_lock, K_FOREVER);
+	nvm_stats.restore_decompress_us = decompress_us;
+	k_mutex_unlock(&nvm_stats_lock);
+
+	LOG_DBG("%d LoRaWAN settings groups decompressed, restored in %"PRIu32" us", decompressed,
+		decompress_us);
+#endif
+
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+	nvm_fcnt_journal_restore(&mib_req.Param.Contexts->Crypto, setting_loaded_Crypto);
+#endif
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(nvm_setting_descriptors); i++) {
+		const struct lorawan_nvm_setting_descr *descr = &nvm_setting_descriptors[i];
+
+		nvm_saved_hashes[i].valid = *descr->loaded;
+		nvm_saved_hashes[i].hash = crc32_ieee(((uint8_t *)mib_req.Param.Contexts + descr->offset),
+						      descr->size);
+	}
+
 	LOG_DBG("Crypto version: %"PRIu32", DevNonce: %d, JoinNonce: %"PRIu32,
 		mib_req.Param.Contexts->Crypto.LrWanVersion.Value,
 		mib_req.Param.Contexts->Crypto.DevNonce,
@@ -139,8 +896,40 @@ LOG_HEXDUMP_ERR(descr->data, descr->size, "data");
 	return 0;
 }
 
+#if CONFIG_LORAWAN_NVM_STATS_LOG_INTERVAL > 0
+static void nvm_stats_log_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(nvm_stats_log_work, nvm_stats_log_work_handler);
+
+static void nvm_stats_log_work_handler(struct k_work *work)
+{
+	struct lorawan_nvm_stats stats;
+	uint32_t group_saves;
+
+	(void)lorawan_nvm_stats_get(&stats);
+	group_saves = stats.saves - stats.journal_saves;
+
+	LOG_INF("NVM saves: %"PRIu32" journal only (avg %"PRIu32" us, %"PRIu32" bytes), %"PRIu32
+		" with groups (avg %"PRIu32" us, %"PRIu32" bytes), max %"PRIu32" us",
+		stats.journal_saves,
+		(stats.journal_saves > 0 ? (uint32_t)(stats.journal_save_us / stats.journal_saves) : 0),
+		(stats.journal_writes > 0 ? (stats.journal_bytes / stats.journal_writes) : 0),
+		group_saves, (group_saves > 0 ? (uint32_t)(stats.group_save_us / group_saves) : 0),
+		(stats.group_writes > 0 ? (stats.group_bytes / stats.group_writes) : 0),
+		stats.max_save_us);
+	LOG_INF("NVM groups: %"PRIu32" unchanged, %"PRIu32" changes coalesced, %"PRIu32
+		" bytes saved by compression", stats.skipped, stats.coalesced, stats.compressed_bytes);
+
+	(void)k_work_reschedule(&nvm_stats_log_work, K_SECONDS(CONFIG_LORAWAN_NVM_STATS_LOG_INTERVAL));
+}
+#endif
+
 int lorawan_nvm_init(void)
 {
+#if CONFIG_LORAWAN_NVM_STATS_LOG_INTERVAL > 0
+	(void)k_work_reschedule(&nvm_stats_log_work, K_SECONDS(CONFIG_LORAWAN_NVM_STATS_LOG_INTERVAL));
+#endif
+
 	return 0;
 }
 
@@ -148,3 +937,12 @@ const struct lorawan_nvm_setting_descr *lorawan_get_nvm_settings()
 {
 	return nvm_setting_descriptors;
 }
+
+int lorawan_nvm_stats_get(struct lorawan_nvm_stats *stats)
+{
+	(void)k_mutex_lock(&nvm_stats_lock, K_FOREVER);
+	*stats = nvm_stats;
+	k_mutex_unlock(&nvm_stats_lock);
+
+	return 0;
+}
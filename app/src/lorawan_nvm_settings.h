@@ -11,8 +11,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-
-#define LORAWAN_SETTINGS_BASE "lorawan/nvm"
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include "lorawan_nvm_groups.h"
 
 struct lorawan_nvm_setting_descr {
 	const char *name;
@@ -22,10 +23,58 @@ struct lorawan_nvm_setting_descr {
 	off_t offset;
 	uint16_t flag;
 	bool *loaded;
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+	/* Changes since the checkpoint (data), as loaded from the delta key */
+	const char *delta_setting_name;
+	uint8_t *delta;
+	uint8_t *delta_size;
+#endif
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+	/* Size of the group as loaded into data, less than size if it is still compressed */
+	uint16_t *stored_size;
+#endif
+};
+
+/* Storage writes of NVM saves, journal writes are frame counter updates which did not need the
+ * Crypto group to be written
+ */
+struct lorawan_nvm_stats {
+	uint32_t saves;
+	uint32_t journal_writes;
+	uint32_t journal_bytes;
+	uint32_t group_writes;
+	uint32_t group_bytes;
+	/* Bytes not written because groups were compressed */
+	uint32_t compressed_bytes;
+	/* Saves which only wrote to the journal, and the time spent in them and all other saves */
+	uint32_t journal_saves;
+	uint64_t journal_save_us;
+	uint64_t group_save_us;
+	uint32_t max_save_us;
+	/* Changes which were saved together with earlier changes which had not been written yet */
+	uint32_t coalesced;
+	/* Groups reported as changed which had the same contents as in storage */
+	uint32_t skipped;
+	/* Time spent decompressing groups in the last restore */
+	uint32_t restore_decompress_us;
 };
 
 extern const uint16_t lorawan_nvm_settings_entries;
 
 const struct lorawan_nvm_setting_descr *lorawan_get_nvm_settings();
 
+/** Wait until all LoRaWAN NVM changes have been written to storage, this is done by sys_reboot()
+ * and sys_poweroff() but must be called before any other reset. Returns -ETIMEDOUT if they were
+ * not written in time, or the error of the save which failed to write them
+ */
+int lorawan_nvm_flush(k_timeout_t timeout);
+
+/** Get statistics of LoRaWAN NVM saves */
+int lorawan_nvm_stats_get(struct lorawan_nvm_stats *stats);
+
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+/** Load a frame counter journal record from settings */
+int lorawan_nvm_fcnt_journal_set(uint8_t slot, size_t len, settings_read_cb read_cb, void *cb_arg);
+#endif
+
 #endif /* APP_LORAWAN_NVM_SETTINGS_H */
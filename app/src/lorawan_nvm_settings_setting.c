@@ -22,26 +22,62 @@ static int lora_nvm_handle_set(const char *name, size_t len, settings_read_cb re
 
 	if (!next) {
 		for (uint32_t i = 0; i < lorawan_nvm_settings_entries; i++) {
-LOG_ERR("names %s vs %s", descr[i].name, name);
-
 			if (strncmp(descr[i].name, name, name_len) == 0) {
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+				/* Groups smaller than their size are compressed, they are decoded when
+				 * the NVM data is restored
+				 */
+				if (len > 0 && len <= descr[i].size) {
+#else
 				if (len == descr[i].size) {
+#endif
 					rc = read_cb(cb_arg, descr[i].data, len);
 
 					if (rc == len) {
 						rc = 0;
 						*descr[i].loaded = true;
+#if defined(CONFIG_LORAWAN_NVM_COMPRESS)
+						*descr[i].stored_size = len;
+#endif
 					}
-LOG_ERR("set!");
 					return rc;
 				} else {
-LOG_ERR("size diff %d vs %d", len, descr[i].size);
 					return -E2BIG;
 				}
 			}
 		}
 	}
 
+#if defined(CONFIG_LORAWAN_NVM_FCNT_JOURNAL)
+	if (next && name_len == strlen(LORAWAN_SETTINGS_FCNT) &&
+	    strncmp(name, LORAWAN_SETTINGS_FCNT, name_len) == 0) {
+		return lorawan_nvm_fcnt_journal_set(strtoul(next, NULL, 10), len, read_cb, cb_arg);
+	}
+#endif
+
+#if defined(CONFIG_LORAWAN_NVM_DELTA)
+	if (next && strcmp(next, LORAWAN_SETTINGS_DELTA) == 0) {
+		for (uint32_t i = 0; i < lorawan_nvm_settings_entries; i++) {
+			if (strncmp(descr[i].name, name, name_len) == 0 &&
+			    descr[i].name[name_len] == '\0') {
+				if (len > CONFIG_LORAWAN_NVM_DELTA_MAX_SIZE) {
+					return -E2BIG;
+				}
+
+				rc = read_cb(cb_arg, descr[i].delta, len);
+
+				if (rc < 0) {
+					return rc;
+				}
+
+				*descr[i].delta_size = rc;
+
+				return 0;
+			}
+		}
+	}
+#endif
+
 	return -ENOENT;
 }
 
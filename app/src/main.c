@@ -6,6 +6,7 @@
 
 #include "ipc_endpoint.h"
 #include "ipc_settings.h"
+#include "ipc_crypto.h"
 #include <zephyr/kernel.h>
 #include <zephyr/settings/settings.h>
 #include <zephyr/logging/log.h>
@@ -28,7 +29,6 @@ int main(void)
 	psa_status_t status;
 #endif
 
-LOG_ERR("aa1");
 	rc = ipc_setup();
 
 	if (rc != 0) {
@@ -41,25 +41,36 @@ LOG_ERR("aa1");
 	rc = settings_load();
 #endif
 
-LOG_ERR("aa2");
+#ifdef CONFIG_IPC_LORAWAN_CRYPTO_SERVER
+	/* Crypto must be ready before the client can send requests, i.e. for the random pool */
+	status = psa_crypto_init();
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Crypto init failed: %d", status);
+	}
+#endif
+
 	rc = ipc_wait_for_ready();
 
 	if (rc != 0) {
 		return 0;
 	}
 
+#ifdef CONFIG_IPC_LORAWAN_CRYPTO_CLIENT
+	ipc_lorawan_crypto_random_pool_refill();
+#endif
+
 #ifdef CONFIG_IPC_SETTINGS_SERVER
-	ipc_setting_boot_load("lorawan");
+	ipc_setting_server_ready();
 #endif
 
-#ifdef CONFIG_IPC_LORAWAN_CRYPTO_SERVER
-	status = psa_crypto_init();
-	if (status != PSA_SUCCESS) {
-		LOG_ERR("Crypto init failed: %d", status);
+#ifdef CONFIG_IPC_SETTINGS_CLIENT
+	rc = ipc_setting_boot_sync("lorawan");
+
+	if (rc != 0) {
+		LOG_ERR("Settings boot sync failed: %d", rc);
 	}
 #endif
 
-LOG_ERR("aa3");
 	while (1) {
 		k_sleep(K_MSEC(2000));
 
@@ -67,7 +78,6 @@ LOG_ERR("aa3");
 		data[1] = up_value++;
 		data[2] = up_value++;
 
-LOG_HEXDUMP_ERR(data, sizeof(data), "in");
 
 		rc = ipc_send_message(0, sizeof(data), data);
 
@@ -10,11 +10,13 @@
 
 LOG_MODULE_DECLARE(settings, CONFIG_SETTINGS_LOG_LEVEL);
 
+static int settings_ipc_save_start(struct settings_store *cs);
 static int settings_ipc_save(struct settings_store *cs, const char *name, const char *value,
 			     size_t val_len);
 static int settings_ipc_save_end(struct settings_store *cs);
 
 static const struct settings_store_itf settings_ipc_interface = {
+	.csi_save_start = settings_ipc_save_start,
 	.csi_save = settings_ipc_save,
 	.csi_save_end = settings_ipc_save_end,
 };
@@ -23,6 +25,12 @@ static /*const*/ struct settings_store ipc_settings_store = {
 	.cs_itf = &settings_ipc_interface,
 };
 
+static int settings_ipc_save_start(struct settings_store *cs)
+{
+	/* Keys saved until the end of the session are sent to the server together */
+	return ipc_setting_batch_begin();
+}
+
 static int settings_ipc_save(struct settings_store *cs, const char *name, const char *value,
 			     size_t val_len)
 {
@@ -35,7 +43,7 @@ static int settings_ipc_save(struct settings_store *cs, const char *name, const
 
 static int settings_ipc_save_end(struct settings_store *cs)
 {
-	return ipc_setting_commit();
+	return ipc_setting_batch_end(true);
 }
 
 int settings_backend_init(void)
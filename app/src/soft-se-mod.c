@@ -0,0 +1,905 @@
+/*
+ * Copyright (c) 2013 Semtech
+ * Copyright (c) 2025, Jamie M.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Modified version of the LoRaMac-node soft secure element which can route each operation either
+ * to the IPC crypto server on the application core or to the local software AES/CMAC
+ * implementation. The hybrid route picks whichever path has been measured to be faster for an
+ * operation type, with the slower path being probed periodically so that the decision follows
+ * changes in IPC latency. All functions are only called from the LoRaMAC context.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "utilities.h"
+#include "aes.h"
+#include "cmac.h"
+#include "LoRaMacHeaderTypes.h"
+#include "secure-element.h"
+#include "se-identity.h"
+#include "soft-se-hal.h"
+#include "ipc_crypto.h"
+#include "soft-se-mod.h"
+
+LOG_MODULE_REGISTER(soft_se_mod, CONFIG_LORAWAN_LOG_LEVEL);
+
+#define AES_BLOCK_SIZE 16
+#define MIC_BLOCK_BX_SIZE 16
+#define MIC_BLOCK_BX_DIRECTION_OFFSET 5
+#define MIC_BLOCK_B0 0x49
+#define AVERAGE_SHIFT 3
+#define PREPARE_RX_MAX_KEYS 3
+
+/*
+ * CMAC computation offset for a LoRaWAN 1.1.x join accept:
+ * JoinReqType | JoinEUI | DevNonce | MHDR
+ */
+#define JOIN_ACCEPT_MIC_COMPUTATION_OFFSET						\
+	(LORAMAC_MHDR_FIELD_SIZE + LORAMAC_JOIN_TYPE_FIELD_SIZE + LORAMAC_JOIN_EUI_FIELD_SIZE +	\
+	 LORAMAC_DEV_NONCE_FIELD_SIZE)
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_ROUTE_IPC)
+#define DEFAULT_ROUTE SOFT_SE_MOD_ROUTE_IPC
+#elif defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_ROUTE_LOCAL)
+#define DEFAULT_ROUTE SOFT_SE_MOD_ROUTE_LOCAL
+#else
+#define DEFAULT_ROUTE SOFT_SE_MOD_ROUTE_HYBRID
+#endif
+
+struct soft_se_mod_key_cache_entry {
+	KeyIdentifier_t key_id;
+	bool valid;
+	uint32_t last_used;
+	lorawan_aes_context context;
+};
+
+static SecureElementNvmData_t *se_nvm;
+static enum soft_se_mod_route soft_se_mod_route = DEFAULT_ROUTE;
+static struct soft_se_mod_stats soft_se_mod_stats[SOFT_SE_MOD_OPERATION_COUNT];
+static uint32_t soft_se_mod_decisions[SOFT_SE_MOD_OPERATION_COUNT];
+static struct soft_se_mod_key_cache_entry key_cache[CONFIG_LORAWAN_BELL_IPC_CRYPTO_KEY_CACHE_ENTRIES];
+static uint32_t key_cache_counter;
+
+/* Bit per KeyList index of keys which the IPC crypto server has loaded, per usage type */
+static atomic_t ipc_key_loaded[2];
+
+BUILD_ASSERT(NUM_OF_KEYS <= 32, "Key loaded tracking only supports 32 keys");
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_PREPARE_RX)
+static void prepare_rx_handler(struct k_work *work);
+
+static K_WORK_DEFINE(prepare_rx_work, prepare_rx_handler);
+/* Set in MAC context before the work is submitted, read once by the work */
+static atomic_t prepare_rx_join;
+#endif
+
+static SecureElementStatus_t get_key_by_id(KeyIdentifier_t key_id, Key_t **key_item)
+{
+	for (uint8_t i = 0; i < NUM_OF_KEYS; i++) {
+		if (se_nvm->KeyList[i].KeyID == key_id) {
+			*key_item = &se_nvm->KeyList[i];
+			return SECURE_ELEMENT_SUCCESS;
+		}
+	}
+
+	return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
+}
+
+static bool is_root_key(KeyIdentifier_t key_id)
+{
+	return (key_id == APP_KEY || key_id == NWK_KEY || key_id == MC_ROOT_KEY ||
+		key_id == MC_KE_KEY);
+}
+
+static void key_cache_invalidate(KeyIdentifier_t key_id)
+{
+	for (uint8_t i = 0; i < ARRAY_SIZE(key_cache); i++) {
+		if (key_cache[i].valid && key_cache[i].key_id == key_id) {
+			key_cache[i].valid = false;
+			memset(&key_cache[i].context, 0, sizeof(key_cache[i].context));
+		}
+	}
+}
+
+static void key_cache_invalidate_all(void)
+{
+	memset(key_cache, 0, sizeof(key_cache));
+	key_cache_counter = 0;
+}
+
+/* Returns the expanded key schedule for a key, evicting the least recently used entry on a miss */
+static const lorawan_aes_context *key_cache_get(const Key_t *key)
+{
+	struct soft_se_mod_key_cache_entry *entry = &key_cache[0];
+
+	for (uint8_t i = 0; i < ARRAY_SIZE(key_cache); i++) {
+		if (key_cache[i].valid && key_cache[i].key_id == key->KeyID) {
+			entry = &key_cache[i];
+			goto finish;
+		}
+
+		if (!key_cache[i].valid) {
+			entry = &key_cache[i];
+		} else if (entry->valid && key_cache[i].last_used < entry->last_used) {
+			entry = &key_cache[i];
+		}
+	}
+
+	memset(&entry->context, 0, sizeof(entry->context));
+	lorawan_aes_set_key(key->KeyValue, SE_KEY_SIZE, &entry->context);
+	entry->key_id = key->KeyID;
+	entry->valid = true;
+
+finish:
+	entry->last_used = ++key_cache_counter;
+
+	return &entry->context;
+}
+
+/* Returns the key schedule to use for a local operation. Root keys which are meant to stay on the
+ * IPC crypto server are not cached, their schedule is expanded into temporary (which the caller
+ * must clear after use) when a local operation is needed because the server failed
+ */
+static const lorawan_aes_context *key_schedule_get(const Key_t *key,
+						   lorawan_aes_context *temporary)
+{
+	if (IS_ENABLED(CONFIG_LORAWAN_BELL_IPC_CRYPTO_ROOT_KEYS_IPC) && is_root_key(key->KeyID)) {
+		memset(temporary, 0, sizeof(*temporary));
+		lorawan_aes_set_key(key->KeyValue, SE_KEY_SIZE, temporary);
+
+		return temporary;
+	}
+
+	return key_cache_get(key);
+}
+
+static void stats_update(enum soft_se_mod_operation operation, bool ipc, uint32_t cycles)
+{
+	struct soft_se_mod_stats *stats = &soft_se_mod_stats[operation];
+	uint32_t *average = (ipc ? &stats->ipc_average_cycles : &stats->local_average_cycles);
+
+	if (ipc) {
+		++stats->ipc_count;
+	} else {
+		++stats->local_count;
+	}
+
+	if (cycles == 0) {
+		cycles = 1;
+	}
+
+	if (*average == 0) {
+		*average = cycles;
+	} else {
+		*average = *average - (*average >> AVERAGE_SHIFT) + (cycles >> AVERAGE_SHIFT);
+	}
+}
+
+static bool use_ipc(enum soft_se_mod_operation operation, KeyIdentifier_t key_id)
+{
+	struct soft_se_mod_stats *stats = &soft_se_mod_stats[operation];
+	bool ipc_faster;
+
+	if (soft_se_mod_route == SOFT_SE_MOD_ROUTE_IPC) {
+		return true;
+	} else if (soft_se_mod_route == SOFT_SE_MOD_ROUTE_LOCAL) {
+		return false;
+	}
+
+	if (IS_ENABLED(CONFIG_LORAWAN_BELL_IPC_CRYPTO_ROOT_KEYS_IPC) && is_root_key(key_id)) {
+		return true;
+	}
+
+	/* Take a sample of each path before comparing them */
+	if (stats->ipc_average_cycles == 0) {
+		return true;
+	} else if (stats->local_average_cycles == 0) {
+		return false;
+	}
+
+	ipc_faster = (stats->ipc_average_cycles <= stats->local_average_cycles);
+
+	if ((++soft_se_mod_decisions[operation] %
+	     CONFIG_LORAWAN_BELL_IPC_CRYPTO_HYBRID_PROBE_INTERVAL) == 0) {
+		return !ipc_faster;
+	}
+
+	return ipc_faster;
+}
+
+static void local_cmac(const Key_t *key, uint8_t *mic_bx_buffer, uint8_t *buffer, uint16_t size,
+		       uint8_t *cmac)
+{
+	AES_CMAC_CTX aes_cmac_ctx;
+	lorawan_aes_context temporary;
+
+	/* Init clears the key schedule so the cached one is restored afterwards */
+	AES_CMAC_Init(&aes_cmac_ctx);
+	memcpy(&aes_cmac_ctx.rijndael, key_schedule_get(key, &temporary),
+	       sizeof(aes_cmac_ctx.rijndael));
+	memset(&temporary, 0, sizeof(temporary));
+
+	if (mic_bx_buffer != NULL) {
+		AES_CMAC_Update(&aes_cmac_ctx, mic_bx_buffer, MIC_BLOCK_BX_SIZE);
+	}
+
+	AES_CMAC_Update(&aes_cmac_ctx, buffer, size);
+	AES_CMAC_Final(cmac, &aes_cmac_ctx);
+	memset(&aes_cmac_ctx, 0, sizeof(aes_cmac_ctx));
+}
+
+static void local_aes_encrypt(const Key_t *key, uint8_t *buffer, uint16_t size, uint8_t *enc_buffer)
+{
+	lorawan_aes_context temporary;
+	const lorawan_aes_context *context = key_schedule_get(key, &temporary);
+	uint16_t block = 0;
+
+	while (block < size) {
+		lorawan_aes_encrypt(&buffer[block], &enc_buffer[block], context);
+		block += AES_BLOCK_SIZE;
+	}
+
+	memset(&temporary, 0, sizeof(temporary));
+}
+
+static void ipc_key_unload(uint8_t index)
+{
+	atomic_and(&ipc_key_loaded[TYPE_AES128], ~BIT(index));
+	atomic_and(&ipc_key_loaded[TYPE_CMAC_AES128], ~BIT(index));
+}
+
+static int ipc_key_load(Key_t *key, uint8_t type)
+{
+	int rc;
+	uint8_t index = (key - se_nvm->KeyList);
+
+	if (atomic_get(&ipc_key_loaded[type]) & BIT(index)) {
+		return 0;
+	}
+
+	rc = ipc_lorawan_crypto_set_key(key->KeyID, key->KeyValue, SE_KEY_SIZE, type);
+
+	if (rc == 0) {
+		atomic_or(&ipc_key_loaded[type], BIT(index));
+	}
+
+	return rc;
+}
+
+static int ipc_cmac(Key_t *key, uint8_t *mic_bx_buffer, uint8_t *buffer, uint16_t size,
+		    uint8_t *cmac)
+{
+	int rc;
+	bool retried = false;
+
+retry:
+	rc = ipc_key_load(key, TYPE_CMAC_AES128);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	rc = ipc_lorawan_crypto_cmac_aes128_encrypt(key->KeyID, buffer, size, mic_bx_buffer,
+						    (mic_bx_buffer != NULL ? MIC_BLOCK_BX_SIZE : 0),
+						    cmac);
+
+	if (rc == -ENOKEY && !retried) {
+		/* Server evicted the key to make space for another */
+		atomic_and(&ipc_key_loaded[TYPE_CMAC_AES128], ~BIT(key - se_nvm->KeyList));
+		retried = true;
+		goto retry;
+	}
+
+	return rc;
+}
+
+static int ipc_aes_encrypt(Key_t *key, uint8_t *buffer, uint16_t size, uint8_t *enc_buffer)
+{
+	int rc;
+	bool retried = false;
+
+retry:
+	rc = ipc_key_load(key, TYPE_AES128);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	rc = ipc_lorawan_crypto_aes128_ecb_encrypt(key->KeyID, buffer, size, enc_buffer);
+
+	if (rc == -ENOKEY && !retried) {
+		atomic_and(&ipc_key_loaded[TYPE_AES128], ~BIT(key - se_nvm->KeyList));
+		retried = true;
+		goto retry;
+	}
+
+	return rc;
+}
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_PREPARE_RX)
+static void prepare_rx_handler(struct k_work *work)
+{
+	static const struct {
+		KeyIdentifier_t key_id;
+		uint8_t type;
+	} join_keys[] = {
+		{ NWK_KEY, TYPE_AES128 },
+		{ NWK_KEY, TYPE_CMAC_AES128 },
+	}, data_keys[] = {
+		{ S_NWK_S_INT_KEY, TYPE_CMAC_AES128 },
+		{ APP_S_KEY, TYPE_AES128 },
+		{ NWK_S_ENC_KEY, TYPE_AES128 },
+	};
+	struct ipc_lorawan_crypto_key keys[PREPARE_RX_MAX_KEYS];
+	uint8_t key_indexes[PREPARE_RX_MAX_KEYS];
+	bool join = (atomic_get(&prepare_rx_join) != 0);
+	uint8_t key_count = (join ? ARRAY_SIZE(join_keys) : ARRAY_SIZE(data_keys));
+	uint8_t count = 0;
+	int rc;
+
+	for (uint8_t i = 0; i < key_count; i++) {
+		KeyIdentifier_t key_id = (join ? join_keys[i].key_id : data_keys[i].key_id);
+		Key_t *key_item;
+
+		if (get_key_by_id(key_id, &key_item) != SECURE_ELEMENT_SUCCESS) {
+			continue;
+		}
+
+		keys[count].key_id = key_id;
+		keys[count].type = (join ? join_keys[i].type : data_keys[i].type);
+		memcpy(keys[count].key, key_item->KeyValue, sizeof(keys[count].key));
+		key_indexes[count] = (key_item - se_nvm->KeyList);
+		++count;
+	}
+
+	rc = ipc_lorawan_crypto_prepare(keys, count);
+
+	if (rc == 0) {
+		for (uint8_t i = 0; i < count; i++) {
+			atomic_or(&ipc_key_loaded[keys[i].type], BIT(key_indexes[i]));
+		}
+	} else {
+		LOG_ERR("Prepare RX failed: %d", rc);
+	}
+
+	memset(keys, 0, sizeof(keys));
+}
+
+/* Called once the MIC of a frame about to be sent is known, downlink can only follow after TX */
+static void prepare_rx(uint8_t *mic_bx_buffer, KeyIdentifier_t key_id)
+{
+	if (soft_se_mod_route == SOFT_SE_MOD_ROUTE_LOCAL) {
+		return;
+	}
+
+	if (mic_bx_buffer == NULL && key_id == NWK_KEY) {
+		atomic_set(&prepare_rx_join, 1);
+	} else if (mic_bx_buffer != NULL && mic_bx_buffer[0] == MIC_BLOCK_B0 &&
+		   mic_bx_buffer[MIC_BLOCK_BX_DIRECTION_OFFSET] == 0) {
+		atomic_set(&prepare_rx_join, 0);
+	} else {
+		return;
+	}
+
+	(void)k_work_submit(&prepare_rx_work);
+}
+#endif
+
+static SecureElementStatus_t compute_cmac(uint8_t *mic_bx_buffer, uint8_t *buffer, uint16_t size,
+					  KeyIdentifier_t key_id, uint32_t *cmac)
+{
+	SecureElementStatus_t retval;
+	Key_t *key_item;
+	uint8_t full_cmac[AES_BLOCK_SIZE];
+	uint32_t start;
+	bool ipc;
+
+	if (buffer == NULL || cmac == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	retval = get_key_by_id(key_id, &key_item);
+
+	if (retval != SECURE_ELEMENT_SUCCESS) {
+		return retval;
+	}
+
+	ipc = use_ipc(SOFT_SE_MOD_OPERATION_CMAC, key_id);
+	start = k_cycle_get_32();
+
+	if (ipc) {
+		int rc = ipc_cmac(key_item, mic_bx_buffer, buffer, size, full_cmac);
+
+		if (rc != 0) {
+			/* Server unavailable, fall back to local unless forced to IPC */
+			LOG_ERR("IPC CMAC failed: %d", rc);
+			++soft_se_mod_stats[SOFT_SE_MOD_OPERATION_CMAC].ipc_failures;
+
+			if (soft_se_mod_route == SOFT_SE_MOD_ROUTE_IPC) {
+				return SECURE_ELEMENT_ERROR;
+			}
+
+			ipc = false;
+			start = k_cycle_get_32();
+			local_cmac(key_item, mic_bx_buffer, buffer, size, full_cmac);
+		}
+	} else {
+		local_cmac(key_item, mic_bx_buffer, buffer, size, full_cmac);
+	}
+
+	stats_update(SOFT_SE_MOD_OPERATION_CMAC, ipc, (k_cycle_get_32() - start));
+
+	*cmac = ((uint32_t)full_cmac[3] << 24 | (uint32_t)full_cmac[2] << 16 |
+		 (uint32_t)full_cmac[1] << 8 | (uint32_t)full_cmac[0]);
+	memset(full_cmac, 0, sizeof(full_cmac));
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+SecureElementStatus_t SecureElementInit(SecureElementNvmData_t *nvm)
+{
+	SecureElementNvmData_t se_nvm_init = {
+		.DevEui = LORAWAN_DEVICE_EUI,
+		.JoinEui = LORAWAN_JOIN_EUI,
+		.Pin = SECURE_ELEMENT_PIN,
+		.KeyList = SOFT_SE_KEY_LIST,
+	};
+
+	if (nvm == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	se_nvm = nvm;
+	memcpy1((uint8_t *)se_nvm, (uint8_t *)&se_nvm_init, sizeof(se_nvm_init));
+	key_cache_invalidate_all();
+	atomic_clear(&ipc_key_loaded[TYPE_AES128]);
+	atomic_clear(&ipc_key_loaded[TYPE_CMAC_AES128]);
+
+#if defined(SECURE_ELEMENT_PRE_PROVISIONED)
+	SoftSeHalGetUniqueId(se_nvm->DevEui);
+#endif
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+SecureElementStatus_t SecureElementSetKey(KeyIdentifier_t keyID, uint8_t *key)
+{
+	if (key == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	for (uint8_t i = 0; i < NUM_OF_KEYS; i++) {
+		if (se_nvm->KeyList[i].KeyID == keyID) {
+			key_cache_invalidate(keyID);
+			ipc_key_unload(i);
+
+			if (keyID == MC_KEY_0 || keyID == MC_KEY_1 || keyID == MC_KEY_2 ||
+			    keyID == MC_KEY_3) {
+				/* Multicast keys are received encrypted with the McKEKey */
+				SecureElementStatus_t retval;
+				uint8_t decrypted_key[SE_KEY_SIZE] = { 0 };
+
+				retval = SecureElementAesEncrypt(key, SE_KEY_SIZE, MC_KE_KEY,
+								 decrypted_key);
+				memcpy1(se_nvm->KeyList[i].KeyValue, decrypted_key, SE_KEY_SIZE);
+				memset(decrypted_key, 0, sizeof(decrypted_key));
+
+				return retval;
+			}
+
+			memcpy1(se_nvm->KeyList[i].KeyValue, key, SE_KEY_SIZE);
+
+			return SECURE_ELEMENT_SUCCESS;
+		}
+	}
+
+	return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
+}
+
+SecureElementStatus_t SecureElementComputeAesCmac(uint8_t *micBxBuffer, uint8_t *buffer,
+						  uint16_t size, KeyIdentifier_t keyID,
+						  uint32_t *cmac)
+{
+	SecureElementStatus_t retval;
+
+	if (keyID >= LORAMAC_CRYPTO_MULTICAST_KEYS) {
+		/* Never accept multicast key identifiers for CMAC computation */
+		return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
+	}
+
+	retval = compute_cmac(micBxBuffer, buffer, size, keyID, cmac);
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_PREPARE_RX)
+	if (retval == SECURE_ELEMENT_SUCCESS) {
+		prepare_rx(micBxBuffer, keyID);
+	}
+#endif
+
+	return retval;
+}
+
+SecureElementStatus_t SecureElementVerifyAesCmac(uint8_t *buffer, uint16_t size,
+						 uint32_t expectedCmac, KeyIdentifier_t keyID)
+{
+	SecureElementStatus_t retval;
+	uint32_t comp_cmac = 0;
+
+	if (buffer == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	retval = compute_cmac(NULL, buffer, size, keyID, &comp_cmac);
+
+	if (retval != SECURE_ELEMENT_SUCCESS) {
+		return retval;
+	}
+
+	if (expectedCmac != comp_cmac) {
+		retval = SECURE_ELEMENT_FAIL_CMAC;
+	}
+
+	return retval;
+}
+
+SecureElementStatus_t SecureElementAesEncrypt(uint8_t *buffer, uint16_t size,
+					      KeyIdentifier_t keyID, uint8_t *encBuffer)
+{
+	SecureElementStatus_t retval;
+	Key_t *key_item;
+	uint32_t start;
+	bool ipc;
+
+	if (buffer == NULL || encBuffer == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	if ((size % AES_BLOCK_SIZE) != 0) {
+		return SECURE_ELEMENT_ERROR_BUF_SIZE;
+	}
+
+	retval = get_key_by_id(keyID, &key_item);
+
+	if (retval != SECURE_ELEMENT_SUCCESS) {
+		return retval;
+	}
+
+	ipc = use_ipc(SOFT_SE_MOD_OPERATION_AES, keyID);
+	start = k_cycle_get_32();
+
+	if (ipc) {
+		int rc = ipc_aes_encrypt(key_item, buffer, size, encBuffer);
+
+		if (rc != 0) {
+			LOG_ERR("IPC AES failed: %d", rc);
+			++soft_se_mod_stats[SOFT_SE_MOD_OPERATION_AES].ipc_failures;
+
+			if (soft_se_mod_route == SOFT_SE_MOD_ROUTE_IPC) {
+				return SECURE_ELEMENT_FAIL_ENCRYPT;
+			}
+
+			ipc = false;
+			start = k_cycle_get_32();
+			local_aes_encrypt(key_item, buffer, size, encBuffer);
+		}
+	} else {
+		local_aes_encrypt(key_item, buffer, size, encBuffer);
+	}
+
+	stats_update(SOFT_SE_MOD_OPERATION_AES, ipc, (k_cycle_get_32() - start));
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+SecureElementStatus_t SecureElementDeriveAndStoreKey(uint8_t *input, KeyIdentifier_t rootKeyID,
+						     KeyIdentifier_t targetKeyID)
+{
+	SecureElementStatus_t retval;
+	uint8_t key[SE_KEY_SIZE] = { 0 };
+
+	if (input == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	/* In case of MC_KE_KEY, only McRootKey can be used as root key */
+	if (targetKeyID == MC_KE_KEY && rootKeyID != MC_ROOT_KEY) {
+		return SECURE_ELEMENT_ERROR_INVALID_KEY_ID;
+	}
+
+	retval = SecureElementAesEncrypt(input, SE_KEY_SIZE, rootKeyID, key);
+
+	if (retval == SECURE_ELEMENT_SUCCESS) {
+		retval = SecureElementSetKey(targetKeyID, key);
+	}
+
+	memset(key, 0, sizeof(key));
+
+	return retval;
+}
+
+SecureElementStatus_t SecureElementProcessJoinAccept(JoinReqIdentifier_t joinReqType,
+						     uint8_t *joinEui, uint16_t devNonce,
+						     uint8_t *encJoinAccept,
+						     uint8_t encJoinAcceptSize,
+						     uint8_t *decJoinAccept, uint8_t *versionMinor)
+{
+	KeyIdentifier_t enc_key_id = NWK_KEY;
+	uint32_t mic;
+
+	if (encJoinAccept == NULL || decJoinAccept == NULL || versionMinor == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	/* Check that frame size isn't bigger than a JoinAccept with CFList size */
+	if (encJoinAcceptSize > LORAMAC_JOIN_ACCEPT_FRAME_MAX_SIZE) {
+		return SECURE_ELEMENT_ERROR_BUF_SIZE;
+	}
+
+	if (joinReqType != JOIN_REQ) {
+		enc_key_id = J_S_ENC_KEY;
+	}
+
+	memcpy1(decJoinAccept, encJoinAccept, encJoinAcceptSize);
+
+	/* Decrypt JoinAccept, skip MHDR */
+	if (SecureElementAesEncrypt(encJoinAccept + LORAMAC_MHDR_FIELD_SIZE,
+				    encJoinAcceptSize - LORAMAC_MHDR_FIELD_SIZE, enc_key_id,
+				    decJoinAccept + LORAMAC_MHDR_FIELD_SIZE) !=
+	    SECURE_ELEMENT_SUCCESS) {
+		return SECURE_ELEMENT_FAIL_ENCRYPT;
+	}
+
+	*versionMinor = ((decJoinAccept[11] & 0x80) == 0x80) ? 1 : 0;
+
+	mic = ((uint32_t)decJoinAccept[encJoinAcceptSize - LORAMAC_MIC_FIELD_SIZE] << 0);
+	mic |= ((uint32_t)decJoinAccept[encJoinAcceptSize - LORAMAC_MIC_FIELD_SIZE + 1] << 8);
+	mic |= ((uint32_t)decJoinAccept[encJoinAcceptSize - LORAMAC_MIC_FIELD_SIZE + 2] << 16);
+	mic |= ((uint32_t)decJoinAccept[encJoinAcceptSize - LORAMAC_MIC_FIELD_SIZE + 3] << 24);
+
+	if (*versionMinor == 0) {
+		/* LoRaWAN 1.0.x: cmac = aes128_cmac(NwkKey, MHDR | JoinNonce | NetID | DevAddr |
+		 * DLSettings | RxDelay | CFList | CFListType)
+		 */
+		if (SecureElementVerifyAesCmac(decJoinAccept,
+					       (encJoinAcceptSize - LORAMAC_MIC_FIELD_SIZE), mic,
+					       NWK_KEY) != SECURE_ELEMENT_SUCCESS) {
+			return SECURE_ELEMENT_FAIL_CMAC;
+		}
+	}
+#if (LORAMAC_VERSION == 0x01010100)
+	else if (*versionMinor == 1) {
+		uint8_t mic_header[JOIN_ACCEPT_MIC_COMPUTATION_OFFSET] = { 0 };
+		uint8_t local_buffer[LORAMAC_JOIN_ACCEPT_FRAME_MAX_SIZE +
+				     JOIN_ACCEPT_MIC_COMPUTATION_OFFSET] = { 0 };
+		uint16_t index = 0;
+
+		/* LoRaWAN 1.1.x: cmac = aes128_cmac(JSIntKey, JoinReqType | JoinEUI | DevNonce |
+		 * MHDR | JoinNonce | NetID | DevAddr | DLSettings | RxDelay | CFList | CFListType)
+		 */
+		mic_header[index++] = (uint8_t)joinReqType;
+		memcpyr(mic_header + index, joinEui, LORAMAC_JOIN_EUI_FIELD_SIZE);
+		index += LORAMAC_JOIN_EUI_FIELD_SIZE;
+		mic_header[index++] = devNonce & 0xFF;
+		mic_header[index++] = (devNonce >> 8) & 0xFF;
+
+		memcpy1(local_buffer, mic_header, JOIN_ACCEPT_MIC_COMPUTATION_OFFSET);
+		memcpy1(local_buffer + JOIN_ACCEPT_MIC_COMPUTATION_OFFSET - 1, decJoinAccept,
+			encJoinAcceptSize);
+
+		if (SecureElementVerifyAesCmac(local_buffer,
+					       encJoinAcceptSize +
+					       JOIN_ACCEPT_MIC_COMPUTATION_OFFSET -
+					       LORAMAC_MHDR_FIELD_SIZE - LORAMAC_MIC_FIELD_SIZE,
+					       mic, J_S_INT_KEY) != SECURE_ELEMENT_SUCCESS) {
+			return SECURE_ELEMENT_FAIL_CMAC;
+		}
+	}
+#endif
+	else {
+		return SECURE_ELEMENT_ERROR_INVALID_LORAWAM_SPEC_VERSION;
+	}
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+SecureElementStatus_t SecureElementRandomNumber(uint32_t *randomNum)
+{
+	if (randomNum == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	/* Pool never blocks, use the radio when it has not been refilled yet */
+	if (ipc_lorawan_crypto_random_get((uint8_t *)randomNum, sizeof(*randomNum)) != 0) {
+		*randomNum = SoftSeHalGetRandomNumber();
+	}
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+SecureElementStatus_t SecureElementSetDevEui(uint8_t *devEui)
+{
+	if (devEui == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	memcpy1(se_nvm->DevEui, devEui, SE_EUI_SIZE);
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+uint8_t *SecureElementGetDevEui(void)
+{
+	return se_nvm->DevEui;
+}
+
+SecureElementStatus_t SecureElementSetJoinEui(uint8_t *joinEui)
+{
+	if (joinEui == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	memcpy1(se_nvm->JoinEui, joinEui, SE_EUI_SIZE);
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+uint8_t *SecureElementGetJoinEui(void)
+{
+	return se_nvm->JoinEui;
+}
+
+SecureElementStatus_t SecureElementSetPin(uint8_t *pin)
+{
+	if (pin == NULL) {
+		return SECURE_ELEMENT_ERROR_NPE;
+	}
+
+	memcpy1(se_nvm->Pin, pin, SE_PIN_SIZE);
+
+	return SECURE_ELEMENT_SUCCESS;
+}
+
+uint8_t *SecureElementGetPin(void)
+{
+	return se_nvm->Pin;
+}
+
+void soft_se_mod_route_set(enum soft_se_mod_route route)
+{
+	soft_se_mod_route = route;
+}
+
+enum soft_se_mod_route soft_se_mod_route_get(void)
+{
+	return soft_se_mod_route;
+}
+
+int soft_se_mod_stats_get(enum soft_se_mod_operation operation, struct soft_se_mod_stats *stats)
+{
+	if (operation >= SOFT_SE_MOD_OPERATION_COUNT || stats == NULL) {
+		return -EINVAL;
+	}
+
+	memcpy(stats, &soft_se_mod_stats[operation], sizeof(*stats));
+
+	return 0;
+}
+
+#if defined(CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK)
+/*
+ * One iteration is the secure element work of a confirmed uplink with a 32 byte payload followed
+ * by a downlink: payload encryption, uplink MIC, downlink MIC verification and decryption.
+ */
+static int benchmark_frame(void)
+{
+	uint8_t b0[MIC_BLOCK_BX_SIZE] = { 0x49 };
+	uint8_t frame[MIC_BLOCK_BX_SIZE + 44] = { 0 };
+	uint8_t payload[2 * AES_BLOCK_SIZE] = { 0 };
+	uint32_t mic;
+
+	if (SecureElementAesEncrypt(payload, sizeof(payload), APP_S_KEY, payload) !=
+	    SECURE_ELEMENT_SUCCESS) {
+		return -EIO;
+	}
+
+	if (SecureElementComputeAesCmac(b0, &frame[MIC_BLOCK_BX_SIZE], 44, F_NWK_S_INT_KEY,
+					&mic) != SECURE_ELEMENT_SUCCESS) {
+		return -EIO;
+	}
+
+	/* Downlink MIC is computed over the B0 block and the frame in a single buffer */
+	frame[0] = 0x49;
+	frame[5] = 0x01;
+
+	if (compute_cmac(NULL, frame, sizeof(frame), S_NWK_S_INT_KEY, &mic) !=
+	    SECURE_ELEMENT_SUCCESS) {
+		return -EIO;
+	}
+
+	if (SecureElementAesEncrypt(payload, AES_BLOCK_SIZE, APP_S_KEY, payload) !=
+	    SECURE_ELEMENT_SUCCESS) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int soft_se_mod_benchmark(void)
+{
+	static const char * const route_names[] = {
+		[SOFT_SE_MOD_ROUTE_IPC] = "IPC",
+		[SOFT_SE_MOD_ROUTE_LOCAL] = "local",
+		[SOFT_SE_MOD_ROUTE_HYBRID] = "hybrid",
+	};
+	static struct soft_se_mod_stats previous_stats[SOFT_SE_MOD_OPERATION_COUNT];
+	static uint32_t previous_decisions[SOFT_SE_MOD_OPERATION_COUNT];
+	enum soft_se_mod_route previous_route = soft_se_mod_route;
+	int rc = 0;
+
+	if (se_nvm == NULL) {
+		return -EBUSY;
+	}
+
+	/* Measurements made here must not feed the averages used to route MAC operations */
+	memcpy(previous_stats, soft_se_mod_stats, sizeof(previous_stats));
+	memcpy(previous_decisions, soft_se_mod_decisions, sizeof(previous_decisions));
+	memset(soft_se_mod_stats, 0, sizeof(soft_se_mod_stats));
+	memset(soft_se_mod_decisions, 0, sizeof(soft_se_mod_decisions));
+
+	for (uint8_t route = SOFT_SE_MOD_ROUTE_IPC; route <= SOFT_SE_MOD_ROUTE_HYBRID; route++) {
+		uint32_t start;
+		uint32_t cycles;
+
+		soft_se_mod_route = route;
+
+		/* Warm up key caches and the hybrid averages before measuring */
+		rc = benchmark_frame();
+
+		if (rc != 0) {
+			break;
+		}
+
+		start = k_cycle_get_32();
+
+		for (uint32_t i = 0; i < CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK_ITERATIONS; i++) {
+			rc = benchmark_frame();
+
+			if (rc != 0) {
+				break;
+			}
+		}
+
+		cycles = k_cycle_get_32() - start;
+
+		if (rc != 0) {
+			break;
+		}
+
+		LOG_INF("%s: %u us per frame (%u iterations)", route_names[route],
+			k_cyc_to_us_floor32(cycles / CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK_ITERATIONS),
+			CONFIG_LORAWAN_BELL_IPC_CRYPTO_BENCHMARK_ITERATIONS);
+	}
+
+	for (uint8_t i = 0; i < SOFT_SE_MOD_OPERATION_COUNT; i++) {
+		LOG_INF("op %d: ipc %u (avg %u cycles, %u failed), local %u (avg %u cycles)", i,
+			soft_se_mod_stats[i].ipc_count, soft_se_mod_stats[i].ipc_average_cycles,
+			soft_se_mod_stats[i].ipc_failures, soft_se_mod_stats[i].local_count,
+			soft_se_mod_stats[i].local_average_cycles);
+	}
+
+	soft_se_mod_route = previous_route;
+	memcpy(soft_se_mod_stats, previous_stats, sizeof(soft_se_mod_stats));
+	memcpy(soft_se_mod_decisions, previous_decisions, sizeof(soft_se_mod_decisions));
+
+	if (rc != 0) {
+		LOG_ERR("Benchmark failed: %d", rc);
+	}
+
+	return rc;
+}
+#endif
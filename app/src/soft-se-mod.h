@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#ifndef APP_SOFT_SE_MOD_H
+#define APP_SOFT_SE_MOD_H
+
+#include <stdint.h>
+
+enum soft_se_mod_route {
+	SOFT_SE_MOD_ROUTE_IPC,
+	SOFT_SE_MOD_ROUTE_LOCAL,
+	SOFT_SE_MOD_ROUTE_HYBRID,
+};
+
+enum soft_se_mod_operation {
+	SOFT_SE_MOD_OPERATION_CMAC,
+	SOFT_SE_MOD_OPERATION_AES,
+
+	SOFT_SE_MOD_OPERATION_COUNT,
+};
+
+struct soft_se_mod_stats {
+	uint32_t ipc_count;
+	uint32_t local_count;
+	uint32_t ipc_failures;
+	/* Moving average of cycles per operation, 0 if no sample yet */
+	uint32_t ipc_average_cycles;
+	uint32_t local_average_cycles;
+};
+
+/** Set routing policy of secure element operations */
+void soft_se_mod_route_set(enum soft_se_mod_route route);
+
+/** Get routing policy of secure element operations */
+enum soft_se_mod_route soft_se_mod_route_get(void);
+
+/** Get statistics for an operation type */
+int soft_se_mod_stats_get(enum soft_se_mod_operation operation, struct soft_se_mod_stats *stats);
+
+/**
+ * Run frame processing benchmark for each routing policy and log the results. The route and the
+ * routing statistics are restored afterwards. Must not be called while LoRaMAC is running, the
+ * benchmark application calls it with no MAC active.
+ */
+int soft_se_mod_benchmark(void);
+
+#endif /* APP_SOFT_SE_MOD_H */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * In-process replacement for ipc_endpoint.c which passes requests straight to the handlers of
+ * the settings server, so that the server and its storage can be benchmarked without a client
+ * core. Messages sent by the server are kept so that the response to a request can be checked,
+ * unsolicited messages (i.e. invalidations) are dropped.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "ipc_endpoint.h"
+#include "ipc_direct.h"
+
+LOG_MODULE_REGISTER(ipc_direct, 4);
+
+static sys_slist_t ipc_registered_handlers = SYS_SLIST_STATIC_INIT(&ipc_registered_handlers);
+static K_MUTEX_DEFINE(ipc_direct_lock);
+static uint8_t transmit_buffer[IPC_MESSAGE_DATA_SIZE];
+
+/* Last message sent by the server for the request being handled */
+static struct {
+	bool waiting;
+	bool received;
+	uint8_t opcode;
+	uint16_t size;
+	uint8_t data[IPC_MESSAGE_DATA_SIZE];
+} response;
+
+int ipc_setup(void)
+{
+	return 0;
+}
+
+int ipc_wait_for_ready(void)
+{
+	return 0;
+}
+
+int ipc_send_message(uint8_t opcode, uint16_t size, const uint8_t *message)
+{
+	if (size > IPC_MESSAGE_DATA_SIZE) {
+		return -EMSGSIZE;
+	}
+
+	(void)k_mutex_lock(&ipc_direct_lock, K_FOREVER);
+
+	if (response.waiting && opcode == response.opcode) {
+		memcpy(response.data, message, size);
+		response.size = size;
+		response.received = true;
+	}
+
+	k_mutex_unlock(&ipc_direct_lock);
+
+	return size;
+}
+
+uint8_t *ipc_get_buffer(void)
+{
+	(void)k_mutex_lock(&ipc_direct_lock, K_FOREVER);
+
+	return transmit_buffer;
+}
+
+int ipc_send_buffer(uint8_t opcode, uint16_t size)
+{
+	int rc;
+
+	rc = ipc_send_message(opcode, size, transmit_buffer);
+	k_mutex_unlock(&ipc_direct_lock);
+
+	return rc;
+}
+
+void ipc_register(struct ipc_group *group)
+{
+	sys_slist_append(&ipc_registered_handlers, &group->node);
+}
+
+void ipc_unregister(struct ipc_group *group)
+{
+	(void)sys_slist_find_and_remove(&ipc_registered_handlers, &group->node);
+}
+
+int ipc_direct_request(uint8_t opcode, const uint8_t *message, uint16_t size)
+{
+	int rc = -ENOTSUP;
+	struct ipc_group *group;
+
+	/* Handlers run on the thread of the caller, one request at a time */
+	(void)k_mutex_lock(&ipc_direct_lock, K_FOREVER);
+	response.waiting = true;
+	response.received = false;
+	response.opcode = opcode;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&ipc_registered_handlers, group, node) {
+		if (group->opcode == opcode) {
+			rc = group->callback(message, size, group->user_data);
+			break;
+		}
+	}
+
+	if (rc >= 0) {
+		if (!response.received || response.size < sizeof(int)) {
+			rc = -EIO;
+		} else {
+			memcpy(&rc, response.data, sizeof(int));
+		}
+	}
+
+	response.waiting = false;
+	k_mutex_unlock(&ipc_direct_lock);
+
+	return rc;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+#ifndef APP_IPC_DIRECT_H
+#define APP_IPC_DIRECT_H
+
+#include <stdint.h>
+
+/**
+ * Pass a request to the handler registered for its opcode on this core and wait for it to be
+ * handled. Returns the rc at the start of the response, or a negative error if the request was
+ * not handled or there was no response.
+ */
+int ipc_direct_request(uint8_t opcode, const uint8_t *message, uint16_t size);
+
+#endif /* APP_IPC_DIRECT_H */
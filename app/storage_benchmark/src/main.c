@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * All right reserved. This code is NOT apache or FOSS/copyleft licensed.
+ */
+
+/*
+ * Runs a model of the LoRaMAC NVM saves of a client against the settings server on its storage
+ * (the simulated flash on native_sim) and reports save and load latency, write amplification,
+ * garbage collection and the RAM used by the storage caches of the build configuration.
+ *
+ * lorawan_nvm_settings.c needs LoRaMAC and the settings client, so it is not built here. Its save
+ * logic (unchanged groups skipped, deltas against a checkpoint, frame counter journal records and
+ * groups written in full compressed) is modelled by the group_*() functions, fcnt_journal_write()
+ * and uplink_save(), which must be kept in step with it. The encodings (lorawan_nvm_encode.c),
+ * the setting names and the setting IDs are the client's own. The group contents are modelled too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/fs/zms.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include "ipc_endpoint.h"
+#include "ipc_settings.h"
+#include "ipc_settings_protocol.h"
+#include "ipc_setting_ids.h"
+#include "lorawan_nvm_encode.h"
+#include "ipc_direct.h"
+
+#if defined(CONFIG_STATS)
+#include <zephyr/stats/stats.h>
+#endif
+
+#ifdef CONFIG_ARCH_POSIX
+#include "posix_board_if.h"
+#endif
+
+LOG_MODULE_REGISTER(storage_benchmark, 4);
+
+#ifdef CONFIG_NATIVE_LIBRARY
+/* Simulated time does not advance while code executes on native_sim, the host clock in ns is used
+ * as the cycle counter instead
+ */
+uint64_t benchmark_host_time_ns(void);
+
+#define BENCHMARK_CYCLES() ((uint32_t)benchmark_host_time_ns())
+#define BENCHMARK_CYCLES_TO_NS(cycles) (cycles)
+#else
+#define BENCHMARK_CYCLES() k_cycle_get_32()
+#define BENCHMARK_CYCLES_TO_NS(cycles) k_cyc_to_ns_floor64(cycles)
+#endif
+
+/* Approximate size of each LoRaMAC NVM group for EU868, the number of uplinks between the MAC
+ * reporting it as changed and the number of uplinks between changes of its contents (0 for groups
+ * which are only reported at join). Groups which are reported without a change are skipped
+ */
+#define NVM_GROUP_PROFILE_Crypto 56, 1, 1
+#define NVM_GROUP_PROFILE_MacGroup1 36, 1, 1
+#define NVM_GROUP_PROFILE_MacGroup2 432, 1, 8
+#define NVM_GROUP_PROFILE_SecureElement 420, 0, 0
+#define NVM_GROUP_PROFILE_RegionGroup1 124, 1, 16
+#define NVM_GROUP_PROFILE_RegionGroup2 228, 64, 64
+#define NVM_GROUP_PROFILE_ClassB 40, 0, 0
+
+struct nvm_group {
+	const char *name;
+	const char *delta_name;
+	uint16_t size;
+	uint16_t notify_period;
+	uint16_t change_period;
+};
+
+#define NVM_GROUP_INDEX(X, _id, _member) NVM_GROUP_ ## _id,
+#define NVM_GROUP_ENTRY(X, _id, _member)						\
+	{ LORAWAN_SETTINGS_BASE "/" #_member,						\
+	  LORAWAN_SETTINGS_BASE "/" #_member "/" LORAWAN_SETTINGS_DELTA,		\
+	  NVM_GROUP_PROFILE_ ## _member },
+
+enum nvm_group_index {
+	LORAWAN_NVM_GROUP_LIST(NVM_GROUP_INDEX, _)
+};
+
+static const struct nvm_group nvm_groups[] = {
+	LORAWAN_NVM_GROUP_LIST(NVM_GROUP_ENTRY, _)
+};
+
+#define NVM_GROUP_MAX_SIZE 432
+
+BUILD_ASSERT(NVM_GROUP_MAX_SIZE <= IPC_SETTING_LOAD_MAX_VALUE_SIZE,
+	     "Groups must fit in a load response");
+
+/* Bytes at the start of a group which are not zero, the rest of the channel and band tables is */
+#define NVM_GROUP_SET_SIZE 32
+
+/* Counter of the Crypto group which changes at each uplink, its bit in a journal record's mask */
+#define NVM_FCNT_UP_MASK BIT(1)
+
+/* Contents of each group as the MAC has it, and as it was last saved */
+static struct {
+	uint8_t image[NVM_GROUP_MAX_SIZE];
+	uint8_t checkpoint[NVM_GROUP_MAX_SIZE];
+	uint32_t saved_hash;
+	bool saved;
+	bool checkpointed;
+	uint16_t delta_saves;
+	bool delta_stored;
+} nvm_state[ARRAY_SIZE(nvm_groups)];
+
+static struct {
+	uint32_t base_crc;
+	bool base_valid;
+	uint8_t records;
+	uint32_t next_seq;
+} nvm_fcnt;
+
+/* Records written by the model, in the same terms as the client's NVM statistics */
+static struct {
+	uint32_t deltas;
+	uint32_t checkpoints;
+	uint32_t journal_records;
+	uint32_t skipped;
+	uint32_t compressed_bytes;
+} nvm_counts;
+
+struct flash_counters {
+	uint32_t bytes_written;
+	uint32_t erases;
+};
+
+static uint32_t samples[MAX(CONFIG_APP_STORAGE_BENCHMARK_UPLINKS, CONFIG_APP_STORAGE_BENCHMARK_LOAD_ITERATIONS)];
+
+/* Save session frame being filled */
+static struct {
+	uint16_t used;
+	uint8_t buffer[IPC_MESSAGE_DATA_SIZE];
+} session;
+
+static void session_reset(void)
+{
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)session.buffer;
+
+	data->flags = 0;
+	data->record_count = 0;
+	session.used = sizeof(struct ipc_setting_save_batch_data);
+}
+
+static int session_send(uint8_t flags)
+{
+	int rc;
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)session.buffer;
+
+	data->flags = flags;
+	rc = ipc_direct_request(IPC_OPCODE_SETTINGS_SAVE_BATCH, session.buffer, session.used);
+	session_reset();
+
+	return rc;
+}
+
+/* Adds a value (or a deletion, with no value) to the session, split over several frames and with
+ * the setting's ID instead of its name if it has one, modelling ipc_setting_batch_add()
+ */
+static int session_add(const char *name, const uint8_t *value, uint16_t value_size)
+{
+	int rc;
+	struct ipc_setting_save_batch_data *data = (struct ipc_setting_save_batch_data *)session.buffer;
+	struct ipc_setting_save_data *record;
+	uint16_t id = ipc_setting_id_find(name);
+	uint8_t name_size = (id != IPC_SETTING_ID_NONE ? sizeof(uint16_t) : (strlen(name) + 1));
+	uint16_t header_size = sizeof(struct ipc_setting_save_data) + name_size;
+	uint16_t offset = 0;
+
+	while (1) {
+		uint16_t space = sizeof(session.buffer) - session.used;
+		uint16_t chunk = value_size - offset;
+
+		if (space < (header_size + MIN(chunk, IPC_SETTING_MIN_CHUNK_SIZE))) {
+			rc = session_send(0);
+
+			if (rc != 0) {
+				return rc;
+			}
+
+			continue;
+		}
+
+		chunk = MIN(chunk, (space - header_size));
+
+		record = (struct ipc_setting_save_data *)&session.buffer[session.used];
+		record->name_size = name_size;
+		record->flags = ((offset + chunk) < value_size ? IPC_SETTING_RECORD_FLAG_MORE : 0);
+		record->value_size = chunk;
+
+		if (id != IPC_SETTING_ID_NONE) {
+			sys_put_le16(id, record->setting);
+			record->flags |= IPC_SETTING_RECORD_FLAG_ID;
+		} else {
+			memcpy(record->setting, name, name_size);
+		}
+
+		if (chunk > 0) {
+			memcpy(&record->setting[name_size], &value[offset], chunk);
+		}
+
+		session.used += header_size + chunk;
+		++data->record_count;
+		offset += chunk;
+
+		if (offset >= value_size) {
+			return 0;
+		}
+	}
+}
+
+#if defined(CONFIG_FLASH_SIMULATOR_STATS)
+static int flash_counter_get(struct stats_hdr *hdr, void *arg, const char *name, uint16_t off)
+{
+	struct flash_counters *counters = (struct flash_counters *)arg;
+	uint32_t value = *(uint32_t *)((uint8_t *)hdr + off);
+
+	if (strcmp(name, "bytes_written") == 0) {
+		counters->bytes_written = value;
+	} else if (strcmp(name, "flash_erase_calls") == 0) {
+		counters->erases = value;
+	}
+
+	return 0;
+}
+#endif
+
+static void flash_counters_get(struct flash_counters *counters)
+{
+	memset(counters, 0, sizeof(*counters));
+
+#if defined(CONFIG_FLASH_SIMULATOR_STATS)
+	struct stats_hdr *hdr = stats_group_find("flash_sim_stats");
+
+	if (hdr == NULL) {
+		LOG_WRN("Flash statistics not found");
+		return;
+	}
+
+	(void)stats_walk(hdr, flash_counter_get, counters);
+#endif
+}
+
+static int sample_compare(const void *a, const void *b)
+{
+	uint32_t first = *(const uint32_t *)a;
+	uint32_t second = *(const uint32_t *)b;
+
+	return (first > second) - (first < second);
+}
+
+static void samples_report(const char *operation, uint32_t count, uint32_t bytes)
+{
+	uint64_t p50_ns;
+	uint64_t p90_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+
+	qsort(samples, count, sizeof(samples[0]), sample_compare);
+
+	p50_ns = BENCHMARK_CYCLES_TO_NS(samples[((count - 1) * 50) / 100]);
+	p90_ns = BENCHMARK_CYCLES_TO_NS(samples[((count - 1) * 90) / 100]);
+	p99_ns = BENCHMARK_CYCLES_TO_NS(samples[((count - 1) * 99) / 100]);
+	max_ns = BENCHMARK_CYCLES_TO_NS(samples[(count - 1)]);
+
+	LOG_INF("%-26s %4u bytes: p50 %llu us, p90 %llu us, p99 %llu us, max %llu us", operation,
+		bytes, p50_ns / 1000, p90_ns / 1000, p99_ns / 1000, max_ns / 1000);
+
+	/* CSV for tracking: operation,bytes,p50_ns,p90_ns,p99_ns,max_ns */
+	printk("storage,latency,%s,%u,%llu,%llu,%llu,%llu\n", operation, bytes, p50_ns, p90_ns,
+	       p99_ns, max_ns);
+}
+
+/* Sets the contents of a group at join, mostly zeros like the channel and band tables */
+static void group_init(uint8_t group)
+{
+	uint8_t *image = nvm_state[group].image;
+	uint16_t i;
+
+	memset(image, 0, nvm_groups[group].size);
+
+	for (i = 0; i < MIN(nvm_groups[group].size, NVM_GROUP_SET_SIZE); ++i) {
+		image[i] = (uint8_t)(((group + 1) * 37) + (i * 11));
+	}
+}
+
+/* Changes the group like an uplink does: a counter at the start and, apart from the Crypto group
+ * where only the frame counter changes, one byte of the rest
+ */
+static void group_update(uint8_t group, uint32_t uplink)
+{
+	uint8_t *image = nvm_state[group].image;
+
+	sys_put_le32(uplink, image);
+
+	if (group != NVM_GROUP_CRYPTO) {
+		image[(sizeof(uint32_t) + (uplink % (nvm_groups[group].size - sizeof(uint32_t))))] ^= 0x01;
+	}
+}
+
+/* Writes a group in full, compressed if that is smaller, modelling nvm_group_write(). Returns the
+ * number of bytes written
+ */
+static int group_write(uint8_t group)
+{
+	const uint8_t *value = nvm_state[group].image;
+	int size = nvm_groups[group].size;
+	int rc;
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_COMPRESS)
+	uint8_t encoded[NVM_GROUP_MAX_SIZE];
+
+	rc = lorawan_nvm_rle_encode(value, size, encoded, (size - 1));
+
+	if (rc >= 0) {
+		nvm_counts.compressed_bytes += size - rc;
+		value = encoded;
+		size = rc;
+	}
+#endif
+
+	rc = session_add(nvm_groups[group].name, value, size);
+
+	return (rc == 0 ? size : rc);
+}
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_DELTA)
+/* Writes a delta of a group against its checkpoint, or a new checkpoint (deleting the delta),
+ * modelling nvm_delta_save(). Returns the number of bytes written
+ */
+static int group_delta_write(uint8_t group)
+{
+	uint8_t delta[CONFIG_APP_STORAGE_BENCHMARK_NVM_DELTA_MAX_SIZE];
+	int size = -ENOMEM;
+	int rc;
+
+	if (nvm_state[group].checkpointed &&
+	    nvm_state[group].delta_saves < CONFIG_APP_STORAGE_BENCHMARK_NVM_DELTA_CHECKPOINT_INTERVAL) {
+		size = lorawan_nvm_delta_encode(nvm_state[group].checkpoint, nvm_state[group].image,
+						nvm_groups[group].size, delta, sizeof(delta));
+	}
+
+	if (size >= 0) {
+		++nvm_state[group].delta_saves;
+		nvm_state[group].delta_stored = true;
+		++nvm_counts.deltas;
+		rc = session_add(nvm_groups[group].delta_name, delta, size);
+
+		return (rc == 0 ? size : rc);
+	}
+
+	size = group_write(group);
+
+	if (size < 0) {
+		return size;
+	}
+
+	memcpy(nvm_state[group].checkpoint, nvm_state[group].image, nvm_groups[group].size);
+	nvm_state[group].checkpointed = true;
+	nvm_state[group].delta_saves = 0;
+	++nvm_counts.checkpoints;
+
+	if (nvm_state[group].delta_stored) {
+		rc = session_add(nvm_groups[group].delta_name, NULL, 0);
+
+		if (rc != 0) {
+			return rc;
+		}
+
+		nvm_state[group].delta_stored = false;
+	}
+
+	return size;
+}
+#endif
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_FCNT_JOURNAL)
+/* Writes a journal record with the frame counter of the Crypto group, modelling
+ * nvm_fcnt_journal_save(). Returns -EAGAIN if the group needs to be written instead, otherwise the
+ * number of bytes written
+ */
+static int fcnt_journal_write(void)
+{
+	uint8_t buffer[(sizeof(struct lorawan_nvm_fcnt_record) + sizeof(uint32_t))];
+	struct lorawan_nvm_fcnt_record *record = (struct lorawan_nvm_fcnt_record *)buffer;
+	char name[sizeof(LORAWAN_SETTINGS_BASE "/" LORAWAN_SETTINGS_FCNT "/") + 3];
+	int rc;
+
+	if (!nvm_fcnt.base_valid || nvm_fcnt.records >= CONFIG_APP_STORAGE_BENCHMARK_NVM_FCNT_JOURNAL_SLOTS) {
+		return -EAGAIN;
+	}
+
+	record->seq = nvm_fcnt.next_seq;
+	record->base_crc = nvm_fcnt.base_crc;
+	record->mask = NVM_FCNT_UP_MASK;
+	record->values[0] = sys_get_le32(nvm_state[NVM_GROUP_CRYPTO].image);
+
+	(void)snprintk(name, sizeof(name), LORAWAN_SETTINGS_BASE "/" LORAWAN_SETTINGS_FCNT "/%d",
+		       (record->seq % CONFIG_APP_STORAGE_BENCHMARK_NVM_FCNT_JOURNAL_SLOTS));
+
+	rc = session_add(name, buffer, sizeof(buffer));
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	++nvm_fcnt.next_seq;
+	++nvm_fcnt.records;
+	++nvm_counts.journal_records;
+
+	return sizeof(buffer);
+}
+#endif
+
+/* Saves the groups which the MAC reports at this uplink (all at join) as one session, modelling
+ * lorawan_nvm_save_settings(). Returns the number of value bytes which were saved
+ */
+static int uplink_save(uint32_t uplink, bool join)
+{
+	int rc = 0;
+	int bytes = 0;
+	uint16_t changed = 0;
+	uint16_t written = 0;
+	uint32_t hashes[ARRAY_SIZE(nvm_groups)];
+	uint8_t i;
+
+	for (i = 0; i < ARRAY_SIZE(nvm_groups); ++i) {
+		uint16_t notify_period = nvm_groups[i].notify_period;
+		uint16_t change_period = nvm_groups[i].change_period;
+
+		if (join) {
+			group_init(i);
+		} else if (notify_period == 0 || (uplink % notify_period) != 0) {
+			continue;
+		}
+
+		if (join || (change_period != 0 && (uplink % change_period) == 0)) {
+			group_update(i, uplink);
+		}
+
+		hashes[i] = crc32_ieee(nvm_state[i].image, nvm_groups[i].size);
+
+		if (nvm_state[i].saved && nvm_state[i].saved_hash == hashes[i]) {
+			++nvm_counts.skipped;
+		} else {
+			changed |= BIT(i);
+		}
+	}
+
+	if (changed == 0) {
+		return 0;
+	}
+
+	session_reset();
+	written = changed;
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_FCNT_JOURNAL)
+	if ((written & BIT(NVM_GROUP_CRYPTO)) != 0) {
+		rc = fcnt_journal_write();
+
+		if (rc >= 0) {
+			written &= ~BIT(NVM_GROUP_CRYPTO);
+			bytes += rc;
+			rc = 0;
+		} else if (rc == -EAGAIN) {
+			rc = 0;
+		}
+	}
+#endif
+
+	for (i = 0; i < ARRAY_SIZE(nvm_groups) && rc >= 0; ++i) {
+		if ((written & BIT(i)) == 0) {
+			continue;
+		}
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_DELTA)
+		rc = group_delta_write(i);
+#else
+		rc = group_write(i);
+#endif
+
+		if (rc >= 0) {
+			bytes += rc;
+		}
+	}
+
+	if (rc >= 0) {
+		rc = session_send(IPC_SETTING_BATCH_FLAG_APPLY);
+	}
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(nvm_groups); ++i) {
+		if ((changed & BIT(i)) != 0) {
+			nvm_state[i].saved_hash = hashes[i];
+			nvm_state[i].saved = true;
+		}
+	}
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_FCNT_JOURNAL)
+	if ((written & BIT(NVM_GROUP_CRYPTO)) != 0) {
+		/* Journal records apply to the Crypto group as it was just written */
+		nvm_fcnt.base_crc = hashes[NVM_GROUP_CRYPTO];
+		nvm_fcnt.base_valid = true;
+		nvm_fcnt.records = 0;
+	}
+#endif
+
+	return bytes;
+}
+
+static int benchmark_saves(void)
+{
+	struct flash_counters before;
+	struct flash_counters after;
+	struct ipc_setting_save_stats stats;
+	uint64_t saved_bytes = 0;
+	uint32_t uplink;
+	uint32_t start;
+	int rc;
+
+#if defined(CONFIG_APP_STORAGE_BENCHMARK_NVM_DELTA)
+	/* Like the client after a restart, storage might hold a delta of any group */
+	for (uplink = 0; uplink < ARRAY_SIZE(nvm_groups); ++uplink) {
+		nvm_state[uplink].delta_stored = true;
+	}
+#endif
+
+	flash_counters_get(&before);
+
+	for (uplink = 0; uplink < CONFIG_APP_STORAGE_BENCHMARK_UPLINKS; ++uplink) {
+		start = BENCHMARK_CYCLES();
+		rc = uplink_save(uplink, (uplink == 0));
+		samples[uplink] = BENCHMARK_CYCLES() - start;
+
+		if (rc < 0) {
+			LOG_ERR("Save of uplink %u failed: %d", uplink, rc);
+			return rc;
+		}
+
+		saved_bytes += rc;
+
+#if CONFIG_APP_STORAGE_BENCHMARK_INTERVAL_MS > 0
+		k_sleep(K_MSEC(CONFIG_APP_STORAGE_BENCHMARK_INTERVAL_MS));
+#endif
+	}
+
+	flash_counters_get(&after);
+	(void)ipc_setting_save_stats_get(&stats);
+
+	samples_report("uplink_save", CONFIG_APP_STORAGE_BENCHMARK_UPLINKS,
+		       (uint32_t)(saved_bytes / CONFIG_APP_STORAGE_BENCHMARK_UPLINKS));
+
+	/* Write amplification is in hundredths, flash bytes written for each value byte saved */
+	LOG_INF("%llu value bytes saved, %u flash bytes written (write amplification %llu.%02llu), %u erases, %u idle garbage collections",
+		saved_bytes, (after.bytes_written - before.bytes_written),
+		(((uint64_t)(after.bytes_written - before.bytes_written) * 100) / MAX(saved_bytes, 1)) / 100,
+		(((uint64_t)(after.bytes_written - before.bytes_written) * 100) / MAX(saved_bytes, 1)) % 100,
+		(after.erases - before.erases), stats.gc_runs);
+
+	printk("storage,saves,%u,%llu,%u,%u,%u\n", CONFIG_APP_STORAGE_BENCHMARK_UPLINKS, saved_bytes,
+	       (after.bytes_written - before.bytes_written), (after.erases - before.erases),
+	       stats.gc_runs);
+
+	LOG_INF("NVM records: %u deltas, %u checkpoints, %u frame counter journal records, %u unchanged groups skipped, %u bytes saved by compression",
+		nvm_counts.deltas, nvm_counts.checkpoints, nvm_counts.journal_records,
+		nvm_counts.skipped, nvm_counts.compressed_bytes);
+
+	printk("storage,nvm,%u,%u,%u,%u,%u\n", nvm_counts.deltas, nvm_counts.checkpoints,
+	       nvm_counts.journal_records, nvm_counts.skipped, nvm_counts.compressed_bytes);
+
+	return 0;
+}
+
+static int benchmark_loads(void)
+{
+	uint8_t buffer[(sizeof(struct ipc_setting_load_data) + SETTINGS_MAX_NAME_LEN + 1)];
+	struct ipc_setting_load_data *data = (struct ipc_setting_load_data *)buffer;
+	uint32_t start;
+	uint32_t i;
+	uint8_t group;
+	int rc;
+
+	for (group = 0; group < ARRAY_SIZE(nvm_groups); ++group) {
+		data->name_size = strlen(nvm_groups[group].name) + 1;
+		data->max_value_size = nvm_groups[group].size;
+		memcpy(data->name, nvm_groups[group].name, data->name_size);
+
+		for (i = 0; i < CONFIG_APP_STORAGE_BENCHMARK_LOAD_ITERATIONS; ++i) {
+			start = BENCHMARK_CYCLES();
+			rc = ipc_direct_request(IPC_OPCODE_SETTINGS_LOAD, buffer,
+						(sizeof(struct ipc_setting_load_data) + data->name_size));
+			samples[i] = BENCHMARK_CYCLES() - start;
+
+			if (rc < 0) {
+				LOG_ERR("Load of %s failed: %d", nvm_groups[group].name, rc);
+				return rc;
+			}
+		}
+
+		/* Every group fits in one load response, rc is the size of the value as stored */
+		samples_report(nvm_groups[group].name, CONFIG_APP_STORAGE_BENCHMARK_LOAD_ITERATIONS, rc);
+	}
+
+	return 0;
+}
+
+static void benchmark_ram_report(void)
+{
+	uint32_t zms_size = sizeof(struct zms_fs);
+	uint32_t ll_cache_size = 0;
+	uint32_t index_size = 0;
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	struct ipc_setting_index_stats stats;
+#endif
+
+#if defined(CONFIG_SETTINGS_ZMS_LL_CACHE)
+	/* Each entry holds the hashes of the previous and next name in the settings list */
+	ll_cache_size = CONFIG_SETTINGS_ZMS_LL_CACHE_SIZE * (2 * sizeof(uint32_t));
+#endif
+
+#if defined(CONFIG_IPC_SETTINGS_INDEX)
+	(void)ipc_setting_index_stats_get(&stats);
+	index_size = stats.ram_size;
+#endif
+
+	/* zms_fs includes the lookup cache if it is enabled */
+	LOG_INF("RAM: zms_fs %u bytes (lookup cache %s), settings list cache %u bytes, key index %u bytes",
+		zms_size, (IS_ENABLED(CONFIG_ZMS_LOOKUP_CACHE) ? "on" : "off"), ll_cache_size,
+		index_size);
+
+	printk("storage,ram,%u,%u,%u\n", zms_size, ll_cache_size, index_size);
+}
+
+/* Storage is erased so that every run starts from the same state */
+static int storage_erase(void)
+{
+	int rc;
+	const struct flash_area *area;
+
+	rc = flash_area_open(FIXED_PARTITION_ID(storage_partition), &area);
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	rc = flash_area_erase(area, 0, area->fa_size);
+	flash_area_close(area);
+
+	return rc;
+}
+
+int main(void)
+{
+	int rc;
+
+	rc = storage_erase();
+
+	if (rc != 0) {
+		LOG_ERR("Storage erase failed: %d", rc);
+		goto finish;
+	}
+
+	rc = settings_subsys_init();
+
+	if (rc == 0) {
+		rc = settings_load();
+	}
+
+	if (rc != 0) {
+		LOG_ERR("Settings init failed: %d", rc);
+		goto finish;
+	}
+
+	ipc_setting_server_ready();
+
+	LOG_INF("Starting settings storage benchmark, %u uplinks, %u ms interval",
+		CONFIG_APP_STORAGE_BENCHMARK_UPLINKS, CONFIG_APP_STORAGE_BENCHMARK_INTERVAL_MS);
+
+	rc = benchmark_saves();
+
+	if (rc == 0) {
+		rc = benchmark_loads();
+	}
+
+	benchmark_ram_report();
+
+	if (rc == 0) {
+		LOG_INF("Benchmark finished");
+	} else {
+		LOG_ERR("Benchmark failed: %d", rc);
+	}
+
+finish:
+#ifdef CONFIG_ARCH_POSIX
+	posix_exit(rc == 0 ? 0 : 1);
+#endif
+
+	return 0;
+}
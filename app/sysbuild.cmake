@@ -4,9 +4,15 @@
 # All right reserved. This code is NOT apache or FOSS/copyleft licensed.
 #
 
+if(SB_CONFIG_APP_REMOTE_IPC_BENCHMARK)
+  set(remote_source_dir ${APP_DIR}/benchmark)
+else()
+  set(remote_source_dir ${APP_DIR}/remote)
+endif()
+
 ExternalZephyrProject_Add(
   APPLICATION remote
-  SOURCE_DIR ${APP_DIR}/remote
+  SOURCE_DIR ${remote_source_dir}
   BOARD bl54l15_breakout/nrf54l15/cpuflpr/lora/xip
   BOARD_REVISION ${BOARD_REVISION}
   BUILD_ONLY y
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2025, Jamie M.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/*
+ * Host side of the native_sim benchmark clock, this file is built by the native simulator
+ * runner against the host C library.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t benchmark_host_time_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
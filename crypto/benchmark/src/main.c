@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ * Copyright (c) 2025, Jamie M.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/logging/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psa/crypto.h>
+#include <psa/crypto_extra.h>
+
+#ifdef CONFIG_BUILD_WITH_TFM
+#include <tfm_ns_interface.h>
+#endif
+
+#ifdef CONFIG_ARCH_POSIX
+#include "posix_board_if.h"
+#endif
+
+#define APP_SUCCESS		(0)
+#define APP_ERROR		(-1)
+#define APP_SUCCESS_MESSAGE "Benchmark finished successfully!"
+#define APP_ERROR_MESSAGE "Benchmark exited with error!"
+
+LOG_MODULE_REGISTER(crypto_benchmark, LOG_LEVEL_DBG);
+
+#define BENCHMARK_KEY_SIZE (16)
+#define BENCHMARK_MAC_SIZE (16)
+
+#if (CONFIG_CRYPTO_BENCHMARK_MAX_SIZE % BENCHMARK_KEY_SIZE) != 0 || \
+	(CONFIG_CRYPTO_BENCHMARK_SIZE_STEP % BENCHMARK_KEY_SIZE) != 0
+#error "Benchmark sizes must be a multiple of the AES block size"
+#endif
+
+#if defined(CONFIG_PSA_CRYPTO_DRIVER_CRACEN)
+#define BENCHMARK_DRIVER "CRACEN"
+#elif defined(CONFIG_PSA_CRYPTO_DRIVER_OBERON)
+#define BENCHMARK_DRIVER "Oberon"
+#else
+#define BENCHMARK_DRIVER "unknown"
+#endif
+
+#ifdef CONFIG_NATIVE_LIBRARY
+/* Simulated time does not advance while code executes on native_sim, the host clock in ns is used
+ * as the cycle counter instead
+ */
+uint64_t benchmark_host_time_ns(void);
+
+#define BENCHMARK_CYCLES() ((uint32_t)benchmark_host_time_ns())
+#define BENCHMARK_CYCLES_TO_NS(cycles) (cycles)
+#define BENCHMARK_CYCLES_PER_SEC (1000000000U)
+#else
+#define BENCHMARK_CYCLES() k_cycle_get_32()
+#define BENCHMARK_CYCLES_TO_NS(cycles) k_cyc_to_ns_floor64(cycles)
+#define BENCHMARK_CYCLES_PER_SEC sys_clock_hw_cycles_per_sec()
+#endif
+
+enum benchmark_type {
+	BENCHMARK_AES_ECB,
+	BENCHMARK_CMAC_SIGN,
+	BENCHMARK_CMAC_VERIFY,
+
+	BENCHMARK_COUNT,
+};
+
+enum benchmark_phase {
+	PHASE_IMPORT,
+	PHASE_SETUP,
+	PHASE_UPDATE,
+	PHASE_FINISH,
+
+	PHASE_COUNT,
+};
+
+static const char * const benchmark_names[BENCHMARK_COUNT] = {
+	"aes_ecb",
+	"cmac_sign",
+	"cmac_verify",
+};
+
+static const char * const phase_names[PHASE_COUNT] = {
+	"import",
+	"setup",
+	"update",
+	"finish",
+};
+
+static const uint8_t m_key[BENCHMARK_KEY_SIZE] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static uint8_t m_plain_text[CONFIG_CRYPTO_BENCHMARK_MAX_SIZE];
+static uint8_t m_encrypted_text[CONFIG_CRYPTO_BENCHMARK_MAX_SIZE];
+static uint8_t m_mac[BENCHMARK_MAC_SIZE];
+
+int crypto_init(void)
+{
+	psa_status_t status;
+
+	/* Initialize PSA Crypto */
+	status = psa_crypto_init();
+	if (status != PSA_SUCCESS)
+		return APP_ERROR;
+
+	return APP_SUCCESS;
+}
+
+static psa_status_t import_key(enum benchmark_type type, psa_key_id_t *key_id)
+{
+	psa_key_attributes_t key_attributes = PSA_KEY_ATTRIBUTES_INIT;
+	psa_status_t status;
+
+	if (type == BENCHMARK_AES_ECB) {
+		psa_set_key_usage_flags(&key_attributes, PSA_KEY_USAGE_ENCRYPT);
+		psa_set_key_algorithm(&key_attributes, PSA_ALG_ECB_NO_PADDING);
+	} else {
+		psa_set_key_usage_flags(&key_attributes, PSA_KEY_USAGE_SIGN_MESSAGE |
+							 PSA_KEY_USAGE_VERIFY_MESSAGE);
+		psa_set_key_algorithm(&key_attributes, PSA_ALG_CMAC);
+	}
+
+	psa_set_key_lifetime(&key_attributes, PSA_KEY_LIFETIME_VOLATILE);
+	psa_set_key_type(&key_attributes, PSA_KEY_TYPE_AES);
+	psa_set_key_bits(&key_attributes, 128);
+
+	status = psa_import_key(&key_attributes, m_key, sizeof(m_key), key_id);
+	psa_reset_key_attributes(&key_attributes);
+
+	return status;
+}
+
+/* Runs one full import/setup/update/finish sequence, adding the cycles of each phase to cycles */
+static int run_once(enum benchmark_type type, size_t size, uint64_t *cycles)
+{
+	psa_status_t status;
+	psa_key_id_t key_id;
+	psa_cipher_operation_t cipher = PSA_CIPHER_OPERATION_INIT;
+	psa_mac_operation_t mac = PSA_MAC_OPERATION_INIT;
+	size_t olen;
+	uint32_t start;
+	uint32_t end;
+	int rc = APP_ERROR;
+
+	start = BENCHMARK_CYCLES();
+	status = import_key(type, &key_id);
+	end = BENCHMARK_CYCLES();
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("psa_import_key failed! (Error: %d)", status);
+		return APP_ERROR;
+	}
+
+	cycles[PHASE_IMPORT] += end - start;
+
+	start = BENCHMARK_CYCLES();
+
+	if (type == BENCHMARK_AES_ECB) {
+		status = psa_cipher_encrypt_setup(&cipher, key_id, PSA_ALG_ECB_NO_PADDING);
+	} else if (type == BENCHMARK_CMAC_SIGN) {
+		status = psa_mac_sign_setup(&mac, key_id, PSA_ALG_CMAC);
+	} else {
+		status = psa_mac_verify_setup(&mac, key_id, PSA_ALG_CMAC);
+	}
+
+	end = BENCHMARK_CYCLES();
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("%s setup failed! (Error: %d)", benchmark_names[type], status);
+		goto finish;
+	}
+
+	cycles[PHASE_SETUP] += end - start;
+
+	start = BENCHMARK_CYCLES();
+
+	if (type == BENCHMARK_AES_ECB) {
+		status = psa_cipher_update(&cipher, m_plain_text, size, m_encrypted_text,
+					   sizeof(m_encrypted_text), &olen);
+	} else {
+		status = psa_mac_update(&mac, m_plain_text, size);
+	}
+
+	end = BENCHMARK_CYCLES();
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("%s update failed! (Error: %d)", benchmark_names[type], status);
+		goto finish;
+	}
+
+	cycles[PHASE_UPDATE] += end - start;
+
+	start = BENCHMARK_CYCLES();
+
+	if (type == BENCHMARK_AES_ECB) {
+		status = psa_cipher_finish(&cipher, m_encrypted_text, sizeof(m_encrypted_text),
+					   &olen);
+	} else if (type == BENCHMARK_CMAC_SIGN) {
+		status = psa_mac_sign_finish(&mac, m_mac, sizeof(m_mac), &olen);
+	} else {
+		status = psa_mac_verify_finish(&mac, m_mac, sizeof(m_mac));
+	}
+
+	end = BENCHMARK_CYCLES();
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("%s finish failed! (Error: %d)", benchmark_names[type], status);
+		goto finish;
+	}
+
+	cycles[PHASE_FINISH] += end - start;
+	rc = APP_SUCCESS;
+
+finish:
+	(void)psa_cipher_abort(&cipher);
+	(void)psa_mac_abort(&mac);
+	(void)psa_destroy_key(key_id);
+
+	return rc;
+}
+
+/* Generates the reference MAC of the payload which the verify benchmark checks against */
+static int prepare_verify(size_t size)
+{
+	psa_status_t status;
+	psa_key_id_t key_id;
+	size_t olen;
+
+	status = import_key(BENCHMARK_CMAC_SIGN, &key_id);
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("psa_import_key failed! (Error: %d)", status);
+		return APP_ERROR;
+	}
+
+	status = psa_mac_compute(key_id, PSA_ALG_CMAC, m_plain_text, size, m_mac, sizeof(m_mac),
+				 &olen);
+	(void)psa_destroy_key(key_id);
+
+	if (status != PSA_SUCCESS) {
+		LOG_INF("psa_mac_compute failed! (Error: %d)", status);
+		return APP_ERROR;
+	}
+
+	return APP_SUCCESS;
+}
+
+static int benchmark_run(enum benchmark_type type, size_t size)
+{
+	uint64_t cycles[PHASE_COUNT] = { 0 };
+	uint64_t total = 0;
+	uint32_t i;
+	int rc;
+
+	if (type == BENCHMARK_CMAC_VERIFY) {
+		rc = prepare_verify(size);
+
+		if (rc != APP_SUCCESS) {
+			return rc;
+		}
+	}
+
+	for (i = 0; i < CONFIG_CRYPTO_BENCHMARK_ITERATIONS; ++i) {
+		rc = run_once(type, size, cycles);
+
+		if (rc != APP_SUCCESS) {
+			return rc;
+		}
+	}
+
+	/* One CSV line per phase so CI can track each value: driver,type,size,phase,cycles,ns */
+	for (i = 0; i < PHASE_COUNT; ++i) {
+		uint64_t average = cycles[i] / CONFIG_CRYPTO_BENCHMARK_ITERATIONS;
+
+		total += average;
+		printk("bench,%s,%s,%u,%s,%llu,%llu\n", BENCHMARK_DRIVER, benchmark_names[type],
+		       (unsigned int)size, phase_names[i], average, BENCHMARK_CYCLES_TO_NS(average));
+	}
+
+	LOG_INF("%-11s %4u bytes: %6llu cycles, %4llu.%03llu us per operation",
+		benchmark_names[type], (unsigned int)size, total,
+		BENCHMARK_CYCLES_TO_NS(total) / 1000, BENCHMARK_CYCLES_TO_NS(total) % 1000);
+
+	return APP_SUCCESS;
+}
+
+int main(void)
+{
+	enum benchmark_type type;
+	size_t size;
+	int rc;
+
+	LOG_INF("Starting crypto benchmark, driver: %s, iterations: %u, cycle clock: %u Hz",
+		BENCHMARK_DRIVER, CONFIG_CRYPTO_BENCHMARK_ITERATIONS,
+		BENCHMARK_CYCLES_PER_SEC);
+
+	rc = crypto_init();
+
+	if (rc != APP_SUCCESS) {
+		LOG_INF(APP_ERROR_MESSAGE);
+		goto finish;
+	}
+
+	for (size = 0; size < sizeof(m_plain_text); ++size) {
+		m_plain_text[size] = (uint8_t)size;
+	}
+
+	printk("bench,driver,type,size,phase,cycles,ns\n");
+
+	for (type = 0; type < BENCHMARK_COUNT; ++type) {
+		for (size = 0; size <= CONFIG_CRYPTO_BENCHMARK_MAX_SIZE;
+		     size += CONFIG_CRYPTO_BENCHMARK_SIZE_STEP) {
+			rc = benchmark_run(type, size);
+
+			if (rc != APP_SUCCESS) {
+				LOG_INF(APP_ERROR_MESSAGE);
+				goto finish;
+			}
+		}
+	}
+
+	LOG_INF(APP_SUCCESS_MESSAGE);
+
+finish:
+#ifdef CONFIG_ARCH_POSIX
+	posix_exit(rc == APP_SUCCESS ? 0 : 1);
+#endif
+
+	return rc;
+}